@@ -14,6 +14,12 @@
  * It does some checking that all files are of the correct type, and
  * just writes the result to stdout, removing headers and padding to
  * the right amount. It also writes some system data to stderr.
+ *
+ * An optional ramdisk image is appended to the system, padded so that it
+ * ends at RAMDISK_END once setup has moved the system down to SYS_BASE,
+ * and its size in KB is stored in the ram_size word of the boot sector.
+ * The image must also start above the memory the kernel is relocated to,
+ * given the kernel end address the image is checked against it as well.
  */
 
 /*
@@ -56,6 +62,12 @@ static int GCC_HEADER = sizeof(struct exec);
  * bootsect etc */
 #define SETUP_SECTS 4
 
+#define SYS_BASE	0x1000		/* setup moves the system here from 0x10000 */
+#define RAMDISK_END	0x80000		/* the ramdisk image ends here, see h/i386.h */
+#define RAMDISK_GAP	0x10000		/* kept free above the system for the decompressor bss and heap */
+#define KERNEL_COPY	(300*1024)	/* startup.S copies the kernel from 0x100000 down to 0, see c/startup.S */
+#define KERNEL_STACK	(4*4096)	/* kernel stack above the kernel end, see h/i386.h */
+
 #define STRINGIFY(x) #x
 
 typedef union {
@@ -104,13 +116,13 @@ void die(const char * str)
 
 void usage(void)
 {
-	die("Usage: build bootsect setup system [rootdev] [> image]");
+	die("Usage: build bootsect setup system [rootdev] [ramdisk [kernel-end]] [> image]");
 }
 
 int main(int argc, char ** argv)
 {
-	int i,c,id,sz,tmp_int;
-	unsigned long sys_size, tmp_long;
+	int i,c,id,sz,tmp_int,sys_bytes,ram_off;
+	unsigned long sys_size, tmp_long, ram_size = 0, kern_end = 0;
 	char buf[1024];
 #ifndef __BFD__
 	struct exec *ex = (struct exec *)buf;
@@ -119,7 +131,7 @@ int main(int argc, char ** argv)
 	struct stat sb;
 	unsigned char setup_sectors;
 
-	if ((argc < 4) || (argc > 5))
+	if ((argc < 4) || (argc > 7))
 		usage();
 	if (argc > 4) {
 		if (!strcmp(argv[4], "CURRENT")) {
@@ -259,6 +271,7 @@ int main(int argc, char ** argv)
 	sys_size = (sz + 15) / 16;
 	if (sys_size > SYS_SIZE)
 		die("System is too big");
+	sys_bytes = sz;
 	while (sz > 0) {
 		int l, n;
 
@@ -277,6 +290,52 @@ int main(int argc, char ** argv)
 		sz -= l;
 	}
 	close(id);
+
+	if (argc > 5) {
+		if ((id=open(argv[5],O_RDONLY,0))<0)
+			die("Unable to open 'ramdisk'");
+		if (fstat (id, &sb)) {
+			perror (argv[5]);
+			die ("Unable to stat 'ramdisk'");
+		}
+		if (argc > 6)
+			kern_end = strtoul(argv[6], NULL, 16);
+		ram_size = (sb.st_size + 1023) / 1024;
+		ram_off = RAMDISK_END - SYS_BASE - ram_size * 1024;
+		if (ram_size > 0xffff || ram_off < sys_bytes + RAMDISK_GAP)
+			die("System and ramdisk are too big");
+		if (ram_off + SYS_BASE < KERNEL_COPY || ram_off + SYS_BASE < kern_end + KERNEL_STACK)
+			die("Ramdisk overlaps the relocated kernel");
+		fprintf (stderr, "Ramdisk is %lu kB\n", ram_size);
+
+		/* pad the system up to the ramdisk, and the ramdisk up to a KB */
+		for (c=0 ; c<sizeof(buf) ; c++)
+			buf[c] = '\0';
+		for (i = sys_bytes ; i < ram_off ; i += c) {
+			c = ram_off - i;
+			if (c > sizeof(buf))
+				c = sizeof(buf);
+			if (write(1, buf, c) != c)
+				die("Write failed");
+		}
+		for (i = 0 ; (c=read(id, buf, sizeof buf)) > 0 ; i += c)
+			if (write(1, buf, c) != c)
+				die("Write failed");
+		if (c != 0)
+			die("read-error on 'ramdisk'");
+		close(id);
+		for (c=0 ; c<sizeof(buf) ; c++)
+			buf[c] = '\0';
+		for ( ; i < ram_size * 1024 ; i += c) {
+			c = ram_size * 1024 - i;
+			if (c > sizeof(buf))
+				c = sizeof(buf);
+			if (write(1, buf, c) != c)
+				die("Write failed");
+		}
+		sys_size = (RAMDISK_END - SYS_BASE) / 16;
+	}
+
 	if (lseek(1, 497, 0) == 497) {
 		if (write(1, &setup_sectors, 1) != 1)
 			die("Write of setup sectors failed");
@@ -287,5 +346,11 @@ int main(int argc, char ** argv)
 		if (write(1, buf, 2) != 2)
 			die("Write failed");
 	}
+	if (ram_size && lseek(1,504,0) == 504) {
+		buf[0] = (ram_size & 0xff);
+		buf[1] = ((ram_size >> 8) & 0xff);
+		if (write(1, buf, 2) != 2)
+			die("Write of ramdisk size failed");
+	}
 	return(0);
 }
@@ -37,6 +37,7 @@ struct screen_info {
 #define DRIVE_INFO (*(struct drive_info *)0x90080)
 #define SCREEN_INFO (*(struct screen_info *)0x90000)
 #define RAMDISK_SIZE (*(unsigned short *)0x901F8)
+#define RAMDISK_END 0x80000	/* a ramdisk image appended by build sits below here */
 #define ORIG_ROOT_DEV (*(unsigned short *)0x901FC)
 #define AUX_DEVICE_INFO (*(unsigned char *)0x901FF)
 
@@ -107,7 +108,7 @@ void *malloc(size_t size)
 
 		return p;
 	}
-	if (free_mem_ptr < 0x90000)
+	if (free_mem_ptr < (RAMDISK_SIZE ? RAMDISK_END - RAMDISK_SIZE * 1024 : 0x90000))
 	return p;
 	puts("memory is tight...");
 	free_mem_ptr = (long)input_data;
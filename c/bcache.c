@@ -0,0 +1,334 @@
+/* Buffer Cache
+ *
+ * This is the block buffer cache, it sits in front of every block device.
+ * Cached blocks are found through a hash on device and block number, kept
+ * on a list from most to least recently used, and the least recently used
+ * block is reused on a miss. Writes only mark a block dirty, dirty blocks
+ * are written back to their device when they are reused or synced.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+
+#define B_DIRTY		0x1		/* block differs from the device 		*/
+
+typedef struct buf buf_t;
+struct buf
+{
+	blkdev_t *dev;			/* device of the block, NULL for an unused buffer 	*/
+	unsigned int blk;		/* block number on the device 				*/
+	unsigned int flags;
+	buf_t *hnext;			/* hash chain 						*/
+	buf_t *prev;			/* lru list, most recently used first 			*/
+	buf_t *next;
+	unsigned char data[BLK_SZ];
+};
+
+static buf_t bcache[BCACHE_SZ];
+static buf_t *bcache_hash[BCACHE_HASH];
+static buf_t *lru_head = NULL;			/* most recently used 			*/
+static buf_t *lru_tail = NULL;			/* least recently used, reused first 	*/
+
+static unsigned int bcache_hits = 0;
+static unsigned int bcache_misses = 0;
+static unsigned int bcache_writebacks = 0;	/* dirty blocks written back 		*/
+
+#define bhash(b, blk)	((((unsigned int)(b) >> 4) ^ (blk)) & (BCACHE_HASH - 1))
+
+
+/*
+* lru_unlink
+*
+* @desc:	take a buffer off the lru list
+*/
+static void lru_unlink(buf_t *bp)
+{
+	if(bp->prev)
+		bp->prev->next = bp->next;
+	else
+		lru_head = bp->next;
+
+	if(bp->next)
+		bp->next->prev = bp->prev;
+	else
+		lru_tail = bp->prev;
+}
+
+/*
+* lru_push
+*
+* @desc:	put a buffer at the most recently used end of the lru list
+*/
+static void lru_push(buf_t *bp)
+{
+	bp->prev = NULL;
+	bp->next = lru_head;
+	if(lru_head)
+		lru_head->prev = bp;
+	else
+		lru_tail = bp;
+	lru_head = bp;
+}
+
+/*
+* hash_unlink
+*
+* @desc:	take a buffer off its hash chain, the buffer no longer holds a block
+*/
+static void hash_unlink(buf_t *bp)
+{
+	buf_t **q;
+
+	for(q = &bcache_hash[bhash(bp->dev, bp->blk)] ; *q && *q != bp ; q = &((*q)->hnext));
+	if(*q)
+		*q = bp->hnext;
+
+	bp->dev = NULL;
+}
+
+/*
+* bflush
+*
+* @desc:	write a dirty buffer back to its device
+*
+* @output:	SYSOK		buffer is clean
+*		SYSERR		device failed the write, the buffer stays dirty
+*/
+static int bflush(buf_t *bp)
+{
+	if(!(bp->flags & B_DIRTY))
+		return SYSOK;
+
+	if((*bp->dev->bwrite)(bp->dev, bp->blk, bp->data) != SYSOK)
+		return SYSERR;
+
+	bp->flags &= ~B_DIRTY;
+	bcache_writebacks++;
+	return SYSOK;
+}
+
+/*
+* bget
+*
+* @desc:	get the buffer holding a block, reusing the least recently used buffer on a miss
+*
+* @param:	b		device
+*		blk		block number
+*		fill		read the block from the device on a miss, FALSE when the caller overwrites all of it
+*
+* @output:	bp		buffer, now the most recently used, NULL when the device failed a read or the write
+*				back of the reused buffer
+*/
+static buf_t *bget(blkdev_t *b, unsigned int blk, Bool fill)
+{
+	buf_t *bp;
+
+	for(bp = bcache_hash[bhash(b, blk)] ; bp ; bp = bp->hnext)
+	{
+		if(bp->dev == b && bp->blk == blk)
+		{
+			bcache_hits++;
+			lru_unlink(bp);
+			lru_push(bp);
+			return bp;
+		}
+	}
+
+	bcache_misses++;
+
+	bp = lru_tail;
+	if(bp->dev)
+	{
+		if(bflush(bp) != SYSOK)
+			return NULL;
+		hash_unlink(bp);
+	}
+
+	if(fill && (*b->bread)(b, blk, bp->data) != SYSOK)
+		return NULL;
+
+	bp->dev = b;
+	bp->blk = blk;
+	bp->flags = 0;
+	bp->hnext = bcache_hash[bhash(b, blk)];
+	bcache_hash[bhash(b, blk)] = bp;
+
+	lru_unlink(bp);
+	lru_push(bp);
+	return bp;
+}
+
+/*
+* bcache_init
+*
+* @desc:	put every buffer on the lru list, unused
+*/
+void bcache_init(void)
+{
+	int i;
+
+	for(i=0 ; i<BCACHE_HASH ; i++)
+		bcache_hash[i] = NULL;
+
+	for(i=0 ; i<BCACHE_SZ ; i++)
+	{
+		bcache[i].dev = NULL;
+		bcache[i].flags = 0;
+		lru_push(&bcache[i]);
+	}
+}
+
+/*
+* bcache_read
+*
+* @desc:	copy device bytes into a proc buffer through the cache
+*
+* @param:	b		device
+*		off		byte offset on the device
+*		p		proc owning buf
+*		buf		proc buffer
+*		len		bytes to copy
+*
+* @output:	cnt		bytes copied, short at the end of the device, SYSERR when the device failed before
+*				any byte was copied
+*/
+int bcache_read(blkdev_t *b, unsigned int off, pcb_t *p, void *buf, int len)
+{
+	buf_t *bp;
+	unsigned int size = b->nblks * BLK_SZ;
+	int n, cnt = 0;
+
+	if(off >= size)
+		return 0;
+	if(len > size - off)
+		len = size - off;
+
+	while(cnt < len)
+	{
+		n = BLK_SZ - (off + cnt) % BLK_SZ;
+		if(n > len - cnt)
+			n = len - cnt;
+
+		bp = bget(b, (off + cnt) / BLK_SZ, TRUE);
+		if(!bp)
+			return cnt ? cnt : SYSERR;
+
+		vm_copy(p, (unsigned char *) buf + cnt, NULL, &bp->data[(off + cnt) % BLK_SZ], n);
+		cnt += n;
+	}
+
+	return cnt;
+}
+
+/*
+* bcache_write
+*
+* @desc:	copy a proc buffer into device bytes through the cache, the blocks are marked dirty
+*
+* @param:	b		device
+*		off		byte offset on the device
+*		p		proc owning buf
+*		buf		proc buffer
+*		len		bytes to copy
+*
+* @output:	cnt		bytes copied, short at the end of the device, SYSERR when the device failed before
+*				any byte was copied
+*
+* @note:	a block that is overwritten whole is not read from the device first
+*/
+int bcache_write(blkdev_t *b, unsigned int off, pcb_t *p, void *buf, int len)
+{
+	buf_t *bp;
+	unsigned int size = b->nblks * BLK_SZ;
+	int n, cnt = 0;
+
+	if(off >= size)
+		return 0;
+	if(len > size - off)
+		len = size - off;
+
+	while(cnt < len)
+	{
+		n = BLK_SZ - (off + cnt) % BLK_SZ;
+		if(n > len - cnt)
+			n = len - cnt;
+
+		bp = bget(b, (off + cnt) / BLK_SZ, n < BLK_SZ);
+		if(!bp)
+			return cnt ? cnt : SYSERR;
+
+		vm_copy(NULL, &bp->data[(off + cnt) % BLK_SZ], p, (unsigned char *) buf + cnt, n);
+		bp->flags |= B_DIRTY;
+		cnt += n;
+	}
+
+	return cnt;
+}
+
+/*
+* bcache_sync
+*
+* @desc:	write back the dirty blocks of a device, the blocks stay cached
+*
+* @param:	b		device, NULL for every device
+*
+* @output:	SYSOK		every dirty block was written back
+*		SYSERR		the device failed a write, the failed blocks stay dirty
+*/
+int bcache_sync(blkdev_t *b)
+{
+	int i, rc = SYSOK;
+
+	for(i=0 ; i<BCACHE_SZ ; i++)
+	{
+		if(bcache[i].dev && (!b || bcache[i].dev == b) && bflush(&bcache[i]) != SYSOK)
+			rc = SYSERR;
+	}
+
+	return rc;
+}
+
+/*
+* bcache_stats
+*
+* @desc:	get the number of block lookups that hit and missed the cache
+*/
+void bcache_stats(unsigned int *hits, unsigned int *misses)
+{
+	*hits = bcache_hits;
+	*misses = bcache_misses;
+}
+
+/*
+* puts_bcache
+*
+* @desc:	output the cache hits, misses, write backs and dirty blocks
+*/
+void puts_bcache(void)
+{
+	int i, dirty = 0;
+
+	for(i=0 ; i<BCACHE_SZ ; i++)
+	{
+		if(bcache[i].dev && bcache[i].flags & B_DIRTY)
+			dirty++;
+	}
+
+	kprintf("bcache: %d hits, %d misses, %d written back, %d dirty\n", bcache_hits, bcache_misses, bcache_writebacks, dirty);
+}
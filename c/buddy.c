@@ -0,0 +1,287 @@
+/* Page Allocator
+ *
+ * This is the power-of-two buddy allocator for page-sized and larger
+ * requests. It manages the page pool at the top of memory, and backs page
+ * tables, committed process stack pages and large kmalloc() buffers.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+#include <i386.h>
+
+#define PAGE_FREE	0x80		/* page_tag flag, page heads a free block 			*/
+#define PAGE_BODY	0xff		/* page_tag value, page lies inside a block but does not head it 	*/
+
+typedef struct page_blk page_blk_t;	/* free block link, kept in the first bytes of the block itself */
+struct page_blk
+{
+	page_blk_t *prev;
+	page_blk_t *next;
+};
+
+unsigned int page_pool_base = 0;	/* first byte of the page pool 				*/
+unsigned int page_pool_end = 0;		/* first byte past the page pool 			*/
+
+static page_blk_t *page_q[BUDDY_ORDERS];	/* free blocks of 2^order pages 			*/
+static int page_q_cnt[BUDDY_ORDERS];
+static int page_free_cnt = 0;			/* free pages over all orders 				*/
+
+/* order of the block each page heads, or'ed with PAGE_FREE while it is free */
+static unsigned char page_tag[PAGE_POOL_SZ / NBPG];
+
+#define page_index(addr)	(((unsigned int)(addr) - page_pool_base) / NBPG)
+#define page_addr(i)		((page_blk_t *) (page_pool_base + (i) * NBPG))
+
+
+/*
+* page_push
+*
+* @desc:	put a block on the free list of its order
+*/
+static void page_push(unsigned int i, int order)
+{
+	page_blk_t *b = page_addr(i);
+
+	b->prev = NULL;
+	b->next = page_q[order];
+	if(b->next)
+		b->next->prev = b;
+	page_q[order] = b;
+
+	page_tag[i] = order | PAGE_FREE;
+	page_q_cnt[order]++;
+}
+
+/*
+* page_unlink
+*
+* @desc:	take a block off the free list of its order
+*/
+static void page_unlink(unsigned int i, int order)
+{
+	page_blk_t *b = page_addr(i);
+
+	if(b->prev)
+		b->prev->next = b->next;
+	else
+		page_q[order] = b->next;
+
+	if(b->next)
+		b->next->prev = b->prev;
+
+	page_tag[i] = PAGE_BODY;
+	page_q_cnt[order]--;
+}
+
+/*
+* buddy_init
+*
+* @desc:	hand the range [base, end) to the page allocator
+*
+* @param:	base		start of the page pool, page aligned
+*		end		end of the page pool, page aligned
+*
+* @note:	the range is split into the largest blocks that are aligned to their own size relative to base,
+*		so a pool that is not a power of two in size still starts out with few blocks
+*/
+void buddy_init(unsigned int base, unsigned int end)
+{
+	unsigned int i, npages;
+	int order;
+
+	if(end - base > PAGE_POOL_SZ)
+		end = base + PAGE_POOL_SZ;
+
+	page_pool_base = base;
+	page_pool_end = end;
+	npages = (end - base) / NBPG;
+
+	for(i=0 ; i<npages ; i++)
+		page_tag[i] = PAGE_BODY;
+
+	for(i=0 ; i<npages ; i += 1 << order)
+	{
+		for(order = BUDDY_ORDERS-1 ; order > 0 ; order--)
+		{
+			if(!(i & ((1 << order) - 1)) && i + (1 << order) <= npages)
+				break;
+		}
+
+		page_push(i, order);
+		page_free_cnt += 1 << order;
+	}
+}
+
+/*
+* page_order
+*
+* @desc:	get the smallest order whose block holds size bytes
+*
+* @output:	order		SYSERR when size exceeds the largest block
+*/
+int page_order(int size)
+{
+	int order = 0;
+
+	while(order < BUDDY_ORDERS && (NBPG << order) < size)
+		order++;
+
+	return order < BUDDY_ORDERS ? order : SYSERR;
+}
+
+/*
+* page_alloc
+*
+* @desc:	allocate a block of 2^order pages
+*
+* @param:	order		block order
+*
+* @output:	addr		page aligned block, NULL when no block of the order or above is free
+*
+* @note:	the smallest free block of at least the requested order is taken, and its upper half is split
+*		off and freed until it has the requested order
+*/
+void *page_alloc(int order)
+{
+	int k;
+	unsigned int i;
+
+	if(order < 0 || order >= BUDDY_ORDERS) return NULL;
+
+	for(k = order ; k < BUDDY_ORDERS && !page_q[k] ; k++);
+	if(k == BUDDY_ORDERS) return NULL;
+
+	i = page_index(page_q[k]);
+	page_unlink(i, k);
+
+	while(k > order)
+	{
+		k--;
+		page_push(i + (1 << k), k);
+	}
+
+	page_tag[i] = order;
+	page_free_cnt -= 1 << order;
+
+	return page_addr(i);
+}
+
+/*
+* page_free
+*
+* @desc:	release a block from page_alloc(), merging it with its buddy for as long as the buddy is free
+*
+* @param:	addr		block address
+*/
+void page_free(void *addr)
+{
+	unsigned int i, buddy;
+	int order;
+
+	if(!is_page(addr)) return;
+
+	i = page_index(addr);
+	order = page_tag[i];
+
+	/* not the head of an allocated block */
+	if(order & PAGE_FREE || order >= BUDDY_ORDERS) return;
+
+	page_free_cnt += 1 << order;
+
+	while(order < BUDDY_ORDERS-1)
+	{
+		buddy = i ^ (1 << order);
+		if(buddy >= (page_pool_end - page_pool_base) / NBPG) break;
+		if(page_tag[buddy] != (order | PAGE_FREE)) break;
+
+		page_unlink(buddy, order);
+		page_tag[i] = PAGE_BODY;
+
+		if(buddy < i)
+			i = buddy;
+		order++;
+	}
+
+	page_push(i, order);
+}
+
+/*
+* is_page
+*
+* @desc:	check whether an address lies within the page pool
+*/
+Bool is_page(void *addr)
+{
+	return (unsigned int) addr >= page_pool_base && (unsigned int) addr < page_pool_end;
+}
+
+/*
+* page_size
+*
+* @desc:	get the size in bytes of the allocated block headed by addr
+*
+* @output:	size		0 when addr does not head an allocated block
+*/
+int page_size(void *addr)
+{
+	int order;
+
+	if(!is_page(addr) || (unsigned int) addr & (NBPG-1)) return 0;
+
+	order = page_tag[page_index(addr)];
+	if(order & PAGE_FREE || order >= BUDDY_ORDERS) return 0;
+
+	return NBPG << order;
+}
+
+/*
+* page_count
+*
+* @desc:	get number of free pages over all orders
+*/
+int page_count(void)
+{
+	return page_free_cnt;
+}
+
+/*
+* page_blocks
+*
+* @desc:	get number of free blocks of an order
+*/
+int page_blocks(int order)
+{
+	if(order < 0 || order >= BUDDY_ORDERS) return SYSERR;
+	return page_q_cnt[order];
+}
+
+/*
+* puts_page_q
+*
+* @desc:	output the number of free blocks for each order
+*/
+void puts_page_q()
+{
+	int order;
+
+	kprintf("page_q: ");
+	for(order=0 ; order<BUDDY_ORDERS ; order++)
+		kprintf("%d:%d ", order, page_q_cnt[order]);
+	kprintf("(%d free pages)\n", page_free_cnt);
+}
@@ -0,0 +1,157 @@
+/* Console Device
+ *
+ * This is the console output device, writes are copied into an output ring
+ * and the ring is flushed to the screen in batches, on every timer tick, when
+ * it fills up, and ahead of any kprintf(). The kernel log is drained ahead of
+ * any write, so at most one of the two holds output not yet on the screen.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <cons.h>
+
+static unsigned char cons_ring[CONS_RING_SZ];	/* output, indexed by the free running counters below modulo CONS_RING_SZ */
+static unsigned int cons_head = 0;		/* bytes written by cons_write() 					*/
+static unsigned int cons_tail = 0;		/* bytes flushed to the screen 						*/
+
+
+/*
+* cons_init
+*
+* @desc:	register the console device
+*/
+void cons_init()
+{
+	devsw_t d;
+
+	memset(&d, 0, sizeof(devsw_t));
+	d.dvnum    	= CONSOLE;
+	d.dvopen   	= cons_open;
+	d.dvclose  	= cons_close;
+	d.dvwrite  	= cons_write;
+	d.dvpoll  	= cons_poll;
+	di_register(&d);
+}
+
+/*
+* cons_open
+*
+* @desc:	the screen needs no setup, opening always succeeds
+*
+* @output:	rc		returns 0 on successful device open
+*/
+int cons_open(devsw_t* d, fd_t *f)
+{
+	return DEV_SUCCESS;
+}
+
+/*
+* cons_close
+*
+* @desc:	flushes any output still held in the ring
+*
+* @output:	rc		returns 0 on successful device close
+*/
+int cons_close(devsw_t* d, fd_t *f)
+{
+	cons_flush();
+	return DEV_SUCCESS;
+}
+
+/*
+* cons_write
+*
+* @desc:	copies a user buffer into the output ring
+*
+* @param:	p		proc writing to the console
+*		d
+*		f
+*		buf		user buffer
+*		buflen		user buffer length
+*
+* @output:	rc		number of bytes written, -1 when buf is not memory the proc may pass in
+*
+* @note:	the ring is flushed whenever it fills up, so a write of any length completes without blocking. kprintf()
+*		output still in the kernel log is drained first, so it is not overtaken
+*/
+int cons_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen)
+{
+	unsigned int n, start;
+	int cnt = 0;
+
+	if(!validate_range(p, buf, buflen))
+		return DEV_ERR;
+
+	klog_flush();
+
+	while(cnt < buflen)
+	{
+		if(cons_head - cons_tail == CONS_RING_SZ)
+			cons_flush();
+
+		/* largest run that neither overflows the ring nor wraps around it */
+		start = cons_head & CONS_RING_MASK;
+		n = CONS_RING_SZ - (cons_head - cons_tail);
+		if(n > CONS_RING_SZ - start)
+			n = CONS_RING_SZ - start;
+		if(n > buflen - cnt)
+			n = buflen - cnt;
+
+		copy_from_user(p, &cons_ring[start], (unsigned char *) buf + cnt, n);
+		cons_head += n;
+		cnt += n;
+	}
+
+	return cnt;
+}
+
+/*
+* cons_poll
+*
+* @desc:	the console never blocks a writer
+*
+* @output:	revents		POLLOUT
+*/
+int cons_poll(devsw_t* d, fd_t *f, unsigned int events)
+{
+	return POLLOUT;
+}
+
+/*
+* cons_flush
+*
+* @desc:	writes every byte held in the output ring to the screen, with one cursor update per run
+*/
+void cons_flush()
+{
+	unsigned int n, start;
+
+	while(cons_tail != cons_head)
+	{
+		start = cons_tail & CONS_RING_MASK;
+		n = cons_head - cons_tail;
+		if(n > CONS_RING_SZ - start)
+			n = CONS_RING_SZ - start;
+
+		/* advance first, kbmwrite() never calls back into the console */
+		cons_tail += n;
+		kbmwrite(&cons_ring[start], n);
+	}
+}
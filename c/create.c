@@ -22,6 +22,7 @@
  */
 
 #include <xeroskernel.h>
+#include <i386.h>
 
 #define STACK_PAD 0x10		/* amount of space the context_frame is shifted from 
 						 	 * the end of the memory allocation 					
@@ -29,6 +30,7 @@
 
 extern pcb_t *stop_q;
 extern pcb_t proc_table[PROC_SZ];
+extern pcb_t *idle_proc;
 
 static int min_pid = MIN_PID;		/* lower bound of used pid region */
 static int max_pid = MIN_PID;		/* upper bound of used pid region */
@@ -52,7 +54,8 @@ static int next_pid = MIN_PID+1;	/* reference to the next pid, the next pid
 */
 int create(void (*func)(void), int stack) 
 {
-	int *mem,pid,i;
+	int pid,i;
+	unsigned int esp;
 	context_frame_t *frame;
 	pcb_t *p = NULL;
 
@@ -66,26 +69,38 @@ int create(void (*func)(void), int stack)
 	p=stop_q;
 	stop_q=stop_q->next;	
 
-	/* alloc memory for process stack */
-	mem = kmalloc(stack); 
-	if(!mem) return -1;
+	/* reserve process stack in an address space from the stack cache, or a new one with only its top page committed */
+	if(vm_alloc(p, stack) == SYSERR)
+	{
+		p->next = stop_q;
+		stop_q = p;
+		return -1;
+	}
 
-	p->mem = (unsigned int*)mem;
+	p->mem = NULL;
+	p->shm_mask = 0;
 
-	/* set process context frame STACK_PAD away from the end of the allocated memory */
-	frame = (context_frame_t *) ((int)mem+stack-sizeof(context_frame_t)-(int)STACK_PAD);	
+	/* set process context frame STACK_PAD away from the top of the reserved stack, 
+	 * the frame is written through its kernel address since the proc address space is not loaded 
+	 */
+	esp = VM_STACK_TOP - sizeof(context_frame_t) - STACK_PAD;
+	frame = (context_frame_t *) vm_phys(p, (void *) esp);
 
 	/* set process context frame and pcb */
 	frame->iret_cs = getCS();
 	frame->iret_eip = (unsigned int) func;
-	frame->esp = (unsigned int)(frame);
+	frame->esp = esp;
 	frame->ebp = frame->esp;
 	frame->eflags = 0x00003200;
 	frame->iret_func = &sysstop;
 
 	p->esp = frame->esp;
 
-	if(func == &idleproc) p->pid = IDLE_PROC_PID;
+	if(func == &idleproc) 
+	{
+		p->pid = IDLE_PROC_PID;
+		idle_proc = p;
+	}
 	else 
 	{
 		/* find unused pid */
@@ -113,6 +128,93 @@ int create(void (*func)(void), int stack)
 		p->fd_table[i].dvmajor = -1;
 
 
+	/* start proc as time sharing at the highest scheduler level with a full quantum */
+	p->sched_class = SCHED_CLASS_TS;
+	p->hint = SCHED_HINT_NORMAL;
+	p->waited = TRUE;
+	p->quantum_ms = 0;
+	p->level = 0;
+	p->slice = quantum(p);
+
+
+	/* add proc to ready queue */
+	p->state = READY_STATE;	
+	p->blocked_senders=NULL;			
+	p->blocked_receivers=NULL;
+	p->ptr=NULL;
+
+	/* idle proc is not queued, the dispatcher runs it whenever the ready_q is empty */
+	ready(p);	
+	return p->pid;
+}
+
+/*
+* fork
+*
+* @desc:	clone the parent process and put the clone on the ready queue
+*
+* @param:	parent		proc to be cloned, it is the proc making the request
+*
+* @output:	pid		pid of the clone, the clone itself resumes with a return code of 0
+*		SYSERR		no free pcb, pid or page frames left
+*
+* @note:	the clone resumes from the same context frame as its parent since its stack lives at the same virtual
+*		address, it inherits the signal handlers, file descriptors and scheduler settings, but not pending 
+*		signals or the real-time class
+*/
+int fork(pcb_t *parent)
+{
+	int pid,i;
+	pcb_t *p = NULL;
+
+	/* remove head of stop queue */
+	if(!stop_q) return SYSERR;
+	p=stop_q;
+	stop_q=stop_q->next;	
+
+	/* clone the address space copy-on-write, the pid is only taken once nothing else can fail */
+	pid = SYSERR;
+	if(vm_fork(p, parent) == SYSOK)
+	{
+		pid = find_pid();
+		if(pid == SYSERR)
+			vm_free(p);
+	}
+
+	if(pid == SYSERR)
+	{
+		p->next = stop_q;
+		stop_q = p;
+		return SYSERR;
+	}
+
+	p->pid = pid;
+	p->mem = NULL;
+	p->shm_mask = 0;
+	shm_fork(p, parent);
+
+	p->esp = parent->esp;
+	p->rc = 0;
+
+	/* inherit signal handlers and masks */
+	for(i=0 ; i<SIG_SZ ; i++) 
+		p->sig_table[i] = parent->sig_table[i];
+
+	p->sig_pend_mask = SIG_OFF;
+	p->sig_install_mask = parent->sig_install_mask;	
+	p->sig_ignore_mask = parent->sig_ignore_mask;
+
+	/* inherit file descriptor table, the clone holds its own reference on every open device */
+	di_fork(p, parent);
+
+	/* inherit time sharing settings */
+	p->sched_class = SCHED_CLASS_TS;
+	p->hint = parent->hint;
+	p->waited = TRUE;
+	p->quantum_ms = parent->quantum_ms;
+	p->level = parent->level;
+	p->slice = quantum(p);
+
 	/* add proc to ready queue */
 	p->state = READY_STATE;	
 	p->blocked_senders=NULL;			
@@ -25,6 +25,7 @@
 
 void _kdb_entry_point(void);		/* keyboard isr 			*/
 void _timer_entry_point(void);		/* timer isr 				*/
+void _uart_entry_point(void);		/* serial isr 				*/
 void _syscall_entry_point(void);	/* system call isr 			*/
 void _common_entry_point(void);		/* system call and interrupt isr 	*/
 
@@ -34,9 +35,13 @@ static unsigned int rc;				/* syscall() call request id 		*/
 static unsigned int interrupt;		/* interrupt code
 									 *  0 - system call
 									 *  1 - timer interrupt
+									 *  2 - keyboard interrupt
+									 *  3 - serial interrupt
 									 */
 static unsigned int args;			/* args passed from syscall() 		*/
 
+extern unsigned int clock_hz;			/* timer tick rate (set in sleep.c) 	*/
+
 /*
 * contextswitch
 *
@@ -103,6 +108,11 @@ int contextswitch( pcb_t *p )
     				pusha   			\n\
 				movl 	$1, %%ecx		\n\
 				jmp	_common_entry_point	\n\
+	_uart_entry_point:					\n\
+				cli				\n\
+    				pusha   			\n\
+				movl 	$3, %%ecx		\n\
+				jmp	_common_entry_point	\n\
 	_syscall_entry_point:					\n\
 				cli				\n\
     				pusha   			\n\
@@ -156,8 +166,12 @@ void contextinit()
 
 	/* set timer interrupt quantum */
 	/* by setting the clock divisor, the kernel has been set as a quantum driven preemption kernel */
-	initPIT(CLOCK_DIVISOR);
+	/* the boot rate is CLOCK_DIVISOR, it can be changed later through sysclock() */
+	initPIT(clock_hz);
 
 	/* set idt vector entry point for keyboard interrupt */
 	set_evec(IRQBASE+0x1, _kdb_entry_point);
+
+	/* set idt vector entry point for serial interrupt */
+	set_evec(IRQBASE+0x4, _uart_entry_point);
 }
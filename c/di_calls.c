@@ -26,54 +26,120 @@
 extern devsw_t dev_table[DEV_SZ];
 
 
+/*
+* di_register
+*
+* @desc:	plugs a driver into the dev_table at its major number
+*
+* @param:	d			driver entry, d->dvnum is the major number
+*		
+* @output:	SYSOK			driver has been registered
+*		SYSERR			major number is out of range or already taken
+*
+* @note:	driver functions left NULL are not supported by the device and fail with SYSERR, called by the
+*		driver init functions at initproc() time
+*/
+int di_register(devsw_t *d)
+{
+	if(d->dvnum >= DEV_SZ || dev_table[d->dvnum].dvopen)
+		return SYSERR;
+
+	dev_table[d->dvnum] = *d;
+	dev_table[d->dvnum].dvopens = 0;
+
+	return SYSOK;
+}
+
+/*
+* di_fd
+*
+* @desc:	get the open file descriptor at fd of proc
+*
+* @output:	f			file descriptor, NULL when fd is out of range or not open
+*/
+static fd_t *di_fd(pcb_t *p, int fd)
+{
+	/* check fd is within the correct range */
+	if(fd < 0 || fd >= FD_SZ)
+		return NULL;
+
+	/* check for valid fd_table entry */
+	if(p->fd_table[fd].dvmajor == -1)
+		return NULL;
+
+	return &(p->fd_table[fd]);
+}
+
+/*
+* di_fd_init
+*
+* @desc:	set up a free fd_table entry for a device unit
+*/
+static fd_t *di_fd_init(pcb_t *p, int fd, int dvmajor, int dvminor)
+{
+	fd_t *f = &(p->fd_table[fd]);
+
+	f->dvmajor = dvmajor;
+	f->dvminor = dvminor;
+	f->flags = 0;
+	f->offset = 0;
+	f->async_sig = -1;
+	f->async_rc = 0;
+
+	return f;
+}
+
 /*
 * di_open
 *
 * @desc:	opens the specified device at device_no
 *
 * @param:	p			proc that is making attempting to open a device
-*		device_no		device to be opened at device number in dev_table
+*		device_no		device to be opened, major number in dev_table or'ed with DEV_MINOR(minor)
 *		
-* @output:	SYSOK			specified device has been opened		
-*		SYSERR			failed device parameter checking
+* @output:	fd			fd_table index for the opened device
+*		SYSERR			failed device parameter checking, no free fd or the driver refused the open
 *
-* @note:	only 1 device can be opened in this operating system, however both ensuring correct device owner and number of opened device are asserted
+* @note:	any number of procs and fds may have a device open, the driver is opened on the first open and 
+*		closed on the last close
 */
 int di_open(pcb_t *p, int device_no)
 {
 	int i;
+	int dvmajor = DEV_MAJOR(device_no);
+	devsw_t *d;
+	fd_t *f;
 
 	/* check device_no is within the correct range */
-	if(device_no < 0 || device_no > DEV_SZ)
+	if(device_no < 0 || dvmajor >= DEV_SZ || !dev_table[dvmajor].dvopen)
+		return -1;
+
+	d = &(dev_table[dvmajor]);
+
+	/* scan for a free spot in the file descriptor table */
+	for(i = 0 ; i<FD_SZ && p->fd_table[i].dvmajor != -1 ; i++);
+	if(i == FD_SZ)
 		return -1;
 
-	/* check device is not opened by any other device */
-    	if(dev_table[device_no].dvowner)
-    		return -1;
+	f = di_fd_init(p, i, dvmajor, DEV_MINOR_OF(device_no));
 
-	/* only 1 kbd device can be opened, echo/non-echo */
-	for(i=0 ; i<DEV_SZ ; i++)
+	if(!d->dvopens && (*d->dvopen)(d, f) != SYSOK)
 	{
-		if(dev_table[i].dvowner) 
-			return -1;
+		f->dvmajor = -1;
+		return -1;
 	}
 
-	/* scan for a free spot in the file descriptor table */
-	for(i = 0 ; i<FD_SZ ; i++)
+	/* a device with per-unit state may refuse the unit */
+	if(d->dvref && (*d->dvref)(d, f, 1) != SYSOK)
 	{
-	       	if(p->fd_table[i].dvmajor == -1)
-		{
-	       		p->fd_table[i].dvmajor = device_no;            
-			dev_table[device_no].dvowner = p->pid;
-
-			(*dev_table[device_no].dvopen)(&(dev_table[device_no]));
-
-			return i;
-		}
+		f->dvmajor = -1;
+		if(!d->dvopens && d->dvclose)
+			(*d->dvclose)(d, f);
+		return -1;
 	}
-            
-	/* no free space found, device not opened */
-	return -1;
+
+	d->dvopens++;
+	return i;
 }
 
 /*
@@ -89,26 +155,25 @@ int di_open(pcb_t *p, int device_no)
 */
 int di_close(pcb_t *p, int fd)
 {
-	int dvmajor;
-
-	/* check fd is within the correct range */
-	if(fd < 0 || fd > FD_SZ)
-		return -1;
+	fd_t *f = di_fd(p, fd);
+	devsw_t *d;
 
-	/* check for valid fd_table entry */
-	if(p->fd_table[fd].dvmajor == -1)
+	if(!f)
 		return -1;
 
-	dvmajor = p->fd_table[fd].dvmajor;
+	d = &(dev_table[f->dvmajor]);
 
-	/* check if the device is owned by the current proc */
-	if(dev_table[dvmajor].dvowner != p->pid)
-		return -1;
+	/* drop reads still queued on the fd */
+	if(d->dvcancel)
+		(*d->dvcancel)(d, p, f);
+	if(d->dvref)
+		(*d->dvref)(d, f, -1);
+	f->dvmajor = -1;
 
-	dev_table[dvmajor].dvowner = 0;
-	p->fd_table[fd].dvmajor = -1;
+	if(--d->dvopens || !d->dvclose)
+		return SYSOK;
 
-	return (*dev_table[dvmajor].dvclose)(&(dev_table[dvmajor]));
+	return (*d->dvclose)(d, f);
 }
 
 /*
@@ -121,32 +186,22 @@ int di_close(pcb_t *p, int fd)
 *		buf			user supplied data buffer to be written to device
 *		buflen			length of data to be written to device
 *
-* @output:	SYSERR			failed device parameter checking	
+* @output:	cnt			number of bytes written to the device
+*		SYSERR			failed device parameter checking, or the device does not support writes
 *
-* @note: 	the implementation of the kbd device does not support syswrite, hence this call will always return SYSERR
+* @note: 	the kbd devices do not support syswrite and always return SYSERR
 */
 int di_write(pcb_t *p, int fd, void *buf, int buflen)
 {
-	int dvmajor;
+	fd_t *f = di_fd(p, fd);
 
-	/* check fd is within the correct range */
-	if(fd < 0 || fd > FD_SZ)
-		return -1;
-
-	/* check for valid fd_table entry */
-	if(p->fd_table[fd].dvmajor == -1)
+	if(!f || !buf || buflen < 0)
 		return -1;
 
-	if(!buf || buflen == 0)
+	if(!dev_table[f->dvmajor].dvwrite)
 		return -1;
 
-	dvmajor = p->fd_table[fd].dvmajor;
-
-	/* check if the device is owned by the current proc */
-	if(dev_table[dvmajor].dvowner != p->pid)
-		return -1;
-
-	return -1;
+	return (*dev_table[f->dvmajor].dvwrite)(p, &(dev_table[f->dvmajor]), f, buf, buflen);
 }
 
 /*
@@ -159,75 +214,278 @@ int di_write(pcb_t *p, int fd, void *buf, int buflen)
 *		buf			user supplied data buffer to copy device buffer
 *		buflen			length of data that can be copied into user buffer
 *		
-* @output:	SYSOK			specified device has been read		
-*		SYSERR			failed device parameter checking
+* @output:	SYSOK			read has been queued, or completed and the proc readied by the device
+*		BLOCKERR		O_NONBLOCK fd has no data ready
+*		SYSERR			failed device parameter checking, or an O_ASYNC read is already pending on fd
 */
 int di_read(pcb_t *p, int fd, void *buf, int buflen)
 {
-	int dvmajor;
+	fd_t *f = di_fd(p, fd);
+	int rc;
 
-	/* check fd is within the correct range */
-	if(fd < 0 || fd > FD_SZ)
+	if(!f || !buf || buflen <= 0)
 		return -1;
 
-	/* check for valid fd_table entry */
-	if(p->fd_table[fd].dvmajor == -1)
+	if(!dev_table[f->dvmajor].dvread)
 		return -1;
 
-	if(!buf || buflen == 0)
-		return -1;
+	if(f->flags & O_ASYNC)
+	{
+		/* one read at a time per fd, the device completes it through di_complete() */
+		if(f->async_rc == BLOCKERR)
+			return -1;
+		f->async_rc = BLOCKERR;
+	}
 
-	dvmajor = p->fd_table[fd].dvmajor;
+	rc = (*dev_table[f->dvmajor].dvread)(p, &(dev_table[f->dvmajor]), f, buf, buflen);
 
-	/* check if the device is owned by the current proc */
-	if(dev_table[dvmajor].dvowner != p->pid)
-		return -1;
-	
-	return (*dev_table[dvmajor].dvread)(p, &(dev_table[dvmajor]), buf, buflen);
+	if(f->flags & O_ASYNC)
+	{
+		if(rc < 0)
+			f->async_rc = rc;
+		/* the proc does not wait for the read */
+		else if(p->state == RUNNING_STATE)
+		{
+			p->rc = SYSOK;
+			p->state = READY_STATE;
+			ready(p);
+		}
+	}
+
+	return rc;
 }
 
 /*
 * di_ioctl
 *
-* @desc:	
+* @desc:	manipulates an opened device with a device specific command
 *
 * @param:	p			proc that is attempting to read a device
 *		fd			fd_table index for opened device in proc fd_table
 *		command			device specific defined macros for manipulating the device
 *		
 * @output:	SYSOK			specified device has been manipulated with command		
-*		SYSERR			failed device parameter checking	
+*		SYSERR			failed device parameter checking, the device does not support command, or
+*					SET_FLAGS while an O_ASYNC read is pending on fd
 *
-* @note:	for the kbd device implemented, only SET_OEF is supported
+* @note:	SET_FLAGS, GET_FLAGS, SET_ASYNC_SIG and GET_ASYNC apply to the fd and are handled here for every 
+*		device, other commands are passed to the device, the kbd device supports SET_EOF, block
+*		devices support BLK_SEEK, BLK_SIZE and BLK_SYNC
 */
 int di_ioctl(pcb_t *p, int fd, unsigned long command, ...)
 {
-	int dvmajor;
+	fd_t *f = di_fd(p, fd);
 	va_list ap;
 	va_start(ap, command);
-	int eof = va_arg(ap, int);
+	int arg = va_arg(ap, int);
 
-	/* check fd is within the correct range */
-	if(fd < 0 || fd > FD_SZ)
+	if(!f)
 		return -1;
 
-	/* check for valid fd_table entry */
-	if(p->fd_table[fd].dvmajor == -1)
-		return -1;
+	switch(command)
+	{
+		case SET_FLAGS:
+			/* a read may either fail or complete later when it can not complete now, not both */
+			if(arg & ~(O_NONBLOCK | O_ASYNC) || arg == (O_NONBLOCK | O_ASYNC))
+				return -1;
+			/* di_complete() picks the completion from the flags, they hold until the pending read is done */
+			if(f->async_rc == BLOCKERR)
+				return -1;
+			f->flags = arg;
+			return SYSOK;
+
+		case GET_FLAGS:
+			return f->flags;
+
+		case SET_ASYNC_SIG:
+			if(arg < -1 || arg >= SIG_SZ)
+				return -1;
+			f->async_sig = arg;
+			return SYSOK;
+
+		case GET_ASYNC:
+			return f->async_rc;
+	}
 
-	/* check for invalid command that is not SET_OEF */
-	if(command != SET_EOF) 
+	if(!dev_table[f->dvmajor].dvcntl)
 		return -1;
 
-	/* check for invalid eof ascii character */
-	if(eof < 0 || eof > 127)
+	return (*dev_table[f->dvmajor].dvcntl)(&(dev_table[f->dvmajor]), f, command, arg);
+}
+
+/*
+* di_pipe
+*
+* @desc:	creates a pipe and opens its read end and write end in two free fds of proc
+*
+* @param:	p			proc creating the pipe
+*		fds			user array receiving the read end fd then the write end fd
+*		
+* @output:	SYSOK			pipe has been created
+*		SYSERR			fds is not memory the proc may pass in, proc has less than two free fds, or no 
+*					pipe is left
+*
+* @note:	the pipe lives until no fd holds either end, fork shares both ends with the child
+*/
+int di_pipe(pcb_t *p, int *fds)
+{
+	int fd[2];
+	int i, end, minor;
+	devsw_t *d = &(dev_table[PIPE]);
+	fd_t *f;
+
+	if(!d->dvref || !validate_range(p, fds, sizeof(fd)))
 		return -1;
 
-	dvmajor = p->fd_table[fd].dvmajor;
+	/* scan for two free spots in the file descriptor table */
+	for(i = 0, end = 0 ; i<FD_SZ && end < 2 ; i++)
+	{
+		if(p->fd_table[i].dvmajor == -1)
+			fd[end++] = i;
+	}
+	if(end < 2)
+		return -1;
 
-	/* check if the device is owned by the current proc */
-	if(dev_table[dvmajor].dvowner != p->pid)
+	minor = pipe_create();
+	if(minor == SYSERR)
 		return -1;
-	
-	return (*dev_table[dvmajor].dvcntl)(eof);
+
+	for(end = 0 ; end < 2 ; end++)
+	{
+		f = di_fd_init(p, fd[end], PIPE, minor | end);
+		(*d->dvref)(d, f, 1);
+		d->dvopens++;
+	}
+
+	copy_to_user(p, fds, fd, sizeof(fd));
+	return SYSOK;
+}
+
+/*
+* di_fork
+*
+* @desc:	take a reference on every device the parent has open, for the fd_table its clone inherits
+*/
+void di_fork(pcb_t *child, pcb_t *parent)
+{
+	int i;
+
+	for(i=0 ; i<FD_SZ ; i++)
+	{
+		child->fd_table[i] = parent->fd_table[i];
+		if(child->fd_table[i].dvmajor != -1)
+		{
+			dev_table[child->fd_table[i].dvmajor].dvopens++;
+			if(dev_table[child->fd_table[i].dvmajor].dvref)
+				(*dev_table[child->fd_table[i].dvmajor].dvref)(&(dev_table[child->fd_table[i].dvmajor]), &(child->fd_table[i]), 1);
+		}
+
+		/* a pending O_ASYNC read completes for the parent only */
+		if(child->fd_table[i].async_rc == BLOCKERR)
+			child->fd_table[i].async_rc = 0;
+	}
+}
+
+/*
+* di_release
+*
+* @desc:	close every fd proc has open, called when the proc stops
+*/
+void di_release(pcb_t *p)
+{
+	int i;
+
+	for(i=0 ; i<FD_SZ ; i++)
+		di_close(p, i);
+}
+
+/*
+* di_cancel
+*
+* @desc:	withdraw a proc blocked on a device, the driver holding the proc readies it
+*
+* @note:	called when a signal interrupts the blocked read or write, O_ASYNC reads of the proc stay queued
+*/
+void di_cancel(pcb_t *p)
+{
+	int i;
+
+	for(i=0 ; i<DEV_SZ && p->state == BLOCK_ON_DEV_STATE ; i++)
+	{
+		if(dev_table[i].dvcancel)
+			(*dev_table[i].dvcancel)(&(dev_table[i]), p, NULL);
+	}
+}
+
+/*
+* di_complete
+*
+* @desc:	called by a device that has completed a queued read
+*
+* @param:	p			proc that queued the read
+*		f			fd the read was queued on
+*		rc			bytes read, or an error
+*
+* @note:	an O_ASYNC read leaves rc for GET_ASYNC and raises the fd's async signal, any other read readies
+*		the blocked proc with rc. a device may call this from within its dvread, before the proc blocks
+*/
+void di_complete(pcb_t *p, fd_t *f, int rc)
+{
+	if(f->flags & O_ASYNC)
+	{
+		f->async_rc = rc;
+		if(f->async_sig != -1)
+			signal(p->pid, f->async_sig);
+		return;
+	}
+
+	p->rc = rc;
+	p->state = READY_STATE;
+	ready(p);
+}
+
+/*
+* di_poll
+*
+* @desc:	get the poll events an open fd of proc is ready for
+*
+* @param:	p			proc polling
+*		fd			fd_table index for opened device in proc fd_table
+*		events			POLLIN and/or POLLOUT
+*
+* @output:	revents			events that are ready, POLLERR when fd is not open or the device reports an error
+*
+* @note:	a device without a dvpoll entry is never ready
+*/
+unsigned int di_poll(pcb_t *p, int fd, unsigned int events)
+{
+	fd_t *f = di_fd(p, fd);
+
+	if(!f)
+		return POLLERR;
+
+	if(!dev_table[f->dvmajor].dvpoll)
+		return 0;
+
+	return (*dev_table[f->dvmajor].dvpoll)(&(dev_table[f->dvmajor]), f, events) & (events | POLLERR);
+}
+
+/*
+* di_wake
+*
+* @desc:	recheck the procs polling a device, called by the device when data arrives or room frees up
+*
+* @note:	a completed poll unlinks its entries from the wait queue, so the queue is walked again from its head
+*/
+void di_wake(devsw_t *d)
+{
+	wait_t *w = d->dvwait;
+
+	while(w)
+	{
+		if(poll_wake(w->p))
+			w = d->dvwait;
+		else
+			w = w->next;
+	}
 }
@@ -27,7 +27,22 @@
 extern pcb_t *stop_q;
 extern pcb_t proc_table[PROC_SZ];
 
-pcb_t *ready_q;
+pcb_t *ready_q[SCHED_LEVELS];		/* one ready queue per scheduler level, level 0 is dispatched first 	*/
+
+pcb_t *idle_proc;			/* idle proc, it is never queued on ready_q 				*/
+extern unsigned int clock_hz;		/* timer tick rate (set in sleep.c) 					*/
+
+static unsigned int sched_ticks = 0;	/* timer ticks since the dispatcher started 			*/
+static unsigned int idle_ticks = 0;	/* timer ticks that were spent in the idle proc 		*/
+static unsigned int sched_quantum[SCHED_LEVELS] = 
+{
+	SCHED_QUANTUM_0, 
+	SCHED_QUANTUM_1, 
+	SCHED_QUANTUM_2 
+};
+
+/* hint a proc is queued by within its level, a proc that has not waited since it last ran is normal at best */
+#define sched_rank(p)	((p)->waited || (p)->hint > SCHED_HINT_NORMAL ? (p)->hint : SCHED_HINT_NORMAL)
 
 /*
 * dispatch
@@ -44,6 +59,22 @@ pcb_t *ready_q;
 *		7. syssleep()
 *		8. syssend()
 *		9. sysrecv()
+*		10. sysschedinfo()
+*		11. sysrtset()
+*		12. sysrtwait()
+*		13. sysyield_to()
+*		14. sysschedhint()
+*		15. sysquantum()
+*		16. sysclock()
+*		17. sysmalloc()
+*		18. sysfree()
+*		19. sysshmcreate()
+*		20. sysshmattach()
+*		21. sysshmdetach()
+*		22. sysmemstats()
+*		23. sysfork()
+*		24. syslogread()
+*		25. syspoll()
 */
 void dispatch() 
 {
@@ -79,6 +110,28 @@ void dispatch()
 	unsigned long cmd;	
 	unsigned char eof;
 
+	/* sched arg(s) */
+	sched_info_t *info;
+	unsigned int period_ms, budget_ms, deadline_ms;
+	unsigned int hint, hz, quantum_ms;
+
+	/* heap arg(s) */
+	unsigned int size;
+
+	/* shm arg(s) */
+	int key;
+
+	/* puts arg(s) */
+	char line[PUTS_SZ];
+
+	/* mem arg(s) */
+	kmem_stats_t mem_stats;
+	int on;
+
+	/* poll arg(s) */
+	pollfd_t *set;
+	int n, timeout;
+
 
         /* start dispatcher */
         for(;;) 
@@ -86,12 +139,11 @@ void dispatch()
                 p = next();
 
                 /* execute the idle proc only when there are no other proc in ready_q */
-                if(p->pid == IDLE_PROC_PID && count() > 0) 
-                {
-                        ready(p);
-                        continue;
-                }
+                if(!p) 
+                        p = idle_proc;
 
+		/* load proc address space, signal delivery below already writes to its stack */
+		vm_switch(p);
 		
 		/* find high priority signal and execute handler */		
 		if(p->sig_pend_mask & p->sig_ignore_mask)
@@ -100,6 +152,9 @@ void dispatch()
                 p->state = RUNNING_STATE;
                 request = contextswitch(p);
 
+                /* a proc requeued without waiting on an event is not queued ahead by its hint */
+                p->waited = FALSE;
+
                 /* service syscall/interrupt requests */
                 switch(request) {
                         case TIMER_INT:
@@ -107,8 +162,48 @@ void dispatch()
                                 if(sleeper() > 0 && tick())
                                         wake();
 
+				/* release any periodic job that has become due */
+				rt_tick();
+
+				/* batch kernel log and console device output once per tick */
+				klog_tick();
+				cons_flush();
+
                                 p->state = READY_STATE;                         
-                                ready(p);               
+
+				/* idle proc has no quantum, account the tick as idle time */
+				if(p == idle_proc)
+					idle_ticks++;
+				/* real-time proc is charged against its budget and is requeued by deadline */
+				else if(p->sched_class == SCHED_CLASS_RT)
+				{
+					if(!rt_charge(p))
+						ready(p);
+				}
+				/* proc keeps the head of its level until its quantum has been used up */
+				else if(p->slice > 1)
+				{
+					p->slice--;
+					ready_head(p);
+				}
+				else
+				{
+#if SCHED_POLICY == SCHED_MLFQ
+					/* proc burnt its full quantum, drop it a level whatever its hint */
+					if(p->level < SCHED_LEVELS-1)
+						p->level++;
+#endif
+					p->slice = quantum(p);
+					ready(p);
+				}
+
+#if SCHED_POLICY == SCHED_MLFQ
+				/* periodically move every proc back to the highest level to avoid starvation */
+				if(++sched_ticks % SCHED_BOOST == 0)
+					boost();
+#else
+				sched_ticks++;
+#endif
         
                                 end_of_intr();
                                 break;
@@ -122,6 +217,15 @@ void dispatch()
 				end_of_intr();
 				break;
 
+			case UART_INT:
+				uart_iint();
+
+				p->state = READY_STATE;
+				ready(p);
+
+				end_of_intr();
+				break;
+
                         case CREATE:    
                                 /* retrieve args passed from syscall() */
                                 ap = (va_list)p->args;
@@ -135,11 +239,201 @@ void dispatch()
                                 ready(p);
                                 break;
 
+                        case FORK:
+                                /* clone proc, the clone is readied with a return code of 0 */
+                                p->rc = fork(p);
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case POLL:
+                                ap = (va_list)p->args;
+                                set = va_arg(ap, pollfd_t*);
+                                n = va_arg(ap, int);
+                                timeout = va_arg(ap, int);
+
+                                /* the proc is readied by poll() or once an entry becomes ready */
+                                poll(p, set, n, timeout);
+                                break;
+
+                        case SYSLOG_READ:
+                                ap = (va_list)p->args;
+                                buffer = va_arg(ap, void*);
+                                buffer_len = va_arg(ap, int);
+
+                                p->rc = klog_read(p, buffer, buffer_len);
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case SCHED_INFO:
+                                ap = (va_list)p->args;
+                                info = va_arg(ap, sched_info_t*);
+
+                                p->rc = sched_info(p, info);
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case RT_SET:
+                                ap = (va_list)p->args;
+                                period_ms = va_arg(ap, unsigned int);
+                                budget_ms = va_arg(ap, unsigned int);
+                                deadline_ms = va_arg(ap, unsigned int);
+
+                                /* admission control is done inside rt_set() */
+                                p->rc = rt_set(p, period_ms, budget_ms, deadline_ms);
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case RT_WAIT:
+                                /* a time sharing proc has no period to wait for */
+                                if(p->sched_class != SCHED_CLASS_RT)
+                                {
+                                        p->rc = SYSERR;
+                                        p->state = READY_STATE;                         
+                                        ready(p);
+                                        break;
+                                }
+
+                                /* job completed, hold proc until its next release */
+                                p->rc = p->rt_overruns;
+                                rt_wait(p);
+                                break;
+
                         case YIELD:
                                 p->state = READY_STATE;                         
                                 ready(p);
                                 break;
 
+                        case YIELD_TO:
+                                ap = (va_list)p->args;
+                                pid = va_arg(ap, unsigned int);
+
+                                /* on success the target is queued ahead of the current proc */
+                                p->rc = yield_to(p, pid);
+                                p->state = READY_STATE;                         
+                                if(p->rc == SYSOK)
+                                        ready(p);
+                                else
+                                        ready_head(p);
+                                break;
+
+                        case QUANTUM:
+                                ap = (va_list)p->args;
+                                quantum_ms = va_arg(ap, unsigned int);
+
+                                /* new quantum applies from the next refill, a bounded one keeps peers from starving */
+                                if(quantum_ms > QUANTUM_MS_MAX)
+                                        p->rc = SYSERR;
+                                else
+                                {
+                                        p->rc = p->quantum_ms;
+                                        p->quantum_ms = quantum_ms;
+                                }
+                                p->state = READY_STATE;                         
+                                ready_head(p);
+                                break;
+
+                        case CLOCK:
+                                ap = (va_list)p->args;
+                                hz = va_arg(ap, unsigned int);
+
+                                p->rc = clock_rate(hz);
+                                p->state = READY_STATE;                         
+                                ready_head(p);
+                                break;
+
+                        case MALLOC:
+                                ap = (va_list)p->args;
+                                size = va_arg(ap, unsigned int);
+
+                                p->rc = (int) vm_grow(p, size);
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case FREE:
+                                ap = (va_list)p->args;
+                                buffer = va_arg(ap, void*);
+
+                                p->rc = vm_shrink(p, (unsigned int) buffer);
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case SHM_CREATE:
+                                ap = (va_list)p->args;
+                                key = va_arg(ap, int);
+                                size = va_arg(ap, unsigned int);
+
+                                p->rc = (int) shm_create(p, key, size);
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case SHM_ATTACH:
+                                ap = (va_list)p->args;
+                                key = va_arg(ap, int);
+
+                                p->rc = (int) shm_attach(p, key);
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case SHM_DETACH:
+                                ap = (va_list)p->args;
+                                buffer = va_arg(ap, void*);
+
+                                p->rc = shm_detach(p, buffer);
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case MEM_STATS:
+                                ap = (va_list)p->args;
+                                buffer = va_arg(ap, void*);
+
+                                kmem_stats(&mem_stats);
+                                stack_cache_stats(&mem_stats.stack_hits, &mem_stats.stack_misses);
+                                p->rc = copy_to_user(p, buffer, &mem_stats, sizeof(kmem_stats_t)) == sizeof(kmem_stats_t) ? SYSOK : SYSERR;
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case MEM_TRACE:
+                                ap = (va_list)p->args;
+                                on = va_arg(ap, int);
+                                buffer = va_arg(ap, void*);
+                                buffer_len = va_arg(ap, int);
+
+                                /* no more than the ring holds is ever copied, which also bounds the size validated */
+                                if(buffer_len > KMEM_TRACE_SZ)
+                                        buffer_len = KMEM_TRACE_SZ;
+
+                                if(buffer_len < 0 || (buffer && buffer_len && !validate_range(p, buffer, buffer_len * sizeof(kmem_trace_t))))
+                                        p->rc = SYSERR;
+                                else
+                                {
+                                        if(on != -1)
+                                                kmem_trace(on);
+                                        p->rc = buffer && buffer_len ? kmem_trace_read(p, buffer, buffer_len) : 0;
+                                }
+                                p->state = READY_STATE;                         
+                                ready(p);
+                                break;
+
+                        case SCHED_HINT:
+                                ap = (va_list)p->args;
+                                pid = va_arg(ap, unsigned int);
+                                hint = va_arg(ap, unsigned int);
+
+                                p->rc = sched_hint(pid, hint);
+                                p->state = READY_STATE;                         
+                                ready_head(p);
+                                break;
+
                         case STOP:
                                 /* release all tasks blocked by current proc */
                                 release(&(p->blocked_senders));
@@ -153,7 +447,14 @@ void dispatch()
                                 set_max_pid();  
                                 set_min_pid();
 
-                                kfree(p->mem);
+                                /* drop proc shared memory references, release its heap arena, and return its
+                                 * address space to the stack cache 
+                                 */
+                                shm_release(p);
+                                vm_free(p);
+
+                                /* close every device the proc still has open */
+                                di_release(p);
                                 break;
                         
                         case GETPID:
@@ -168,8 +469,10 @@ void dispatch()
                                 ap = (va_list)p->args;
                                 str = va_arg(ap, char*);
                 
-                                if(str)
-                                        kprintf("%s\n\0", str);
+                                /* the string is copied in first, a bad pointer must not be read by the kernel */
+                                p->rc = str ? copy_str_from_user(p, line, str, PUTS_SZ) : SYSERR;
+                                if(p->rc != SYSERR)
+                                        kprintf("%s\n", line);
         
                                 p->state = READY_STATE;                         
                                 ready(p);                               
@@ -283,17 +586,20 @@ void dispatch()
 				break;
 
 			case DEV_WRITE:
-				/* device driver write not supported */
                                 ap = (va_list)p->args;
                                 fd_no = va_arg(ap, int);
                                 buffer = va_arg(ap, void*);
                                 buffer_len = va_arg(ap, int);
 
-				/* write device */
-				p->rc = di_write(p, fd_no, buffer, buffer_len);			
-				
-                                p->state = READY_STATE;                         				
-				ready(p);
+				/* write device, the device may block the proc until its output has been queued */
+				orc = di_write(p, fd_no, buffer, buffer_len);
+
+				if(p->state == RUNNING_STATE)
+				{
+					p->rc = orc;
+	                                p->state = READY_STATE;
+					ready(p);
+				}
 				break;
 
 			case DEV_READ:
@@ -302,15 +608,16 @@ void dispatch()
                                 buffer = va_arg(ap, void*);
                                 buffer_len = va_arg(ap, int);
 
-				/* read device */
-				p->rc = di_read(p, fd_no, buffer, buffer_len);
+				/* read device, the device may complete the read right away and ready the proc itself */
+				orc = di_read(p, fd_no, buffer, buffer_len);
 
-				if(p->rc == -1)
+				if(orc < 0)
 				{
+					p->rc = orc;
 					p->state = READY_STATE;
 					ready(p);
 				}
-				else
+				else if(p->state == RUNNING_STATE)
 					p->state = BLOCK_ON_DEV_STATE;
 	
 				break;
@@ -321,13 +628,37 @@ void dispatch()
                                 cmd = va_arg(ap, unsigned long);
                                 eof = va_arg(ap, int);
 
-				/* adjust eof for kbd */
+				/* device specific command, e.g. adjust eof for kbd */
 				p->rc = di_ioctl(p, fd_no, cmd, eof);
 
                                 p->state = READY_STATE;                         				
 				ready(p);
 				break;
+
+			case DEV_PIPE:
+                                ap = (va_list)p->args;
+                                buffer = va_arg(ap, void*);
+
+				/* create pipe, both ends are opened in the proc fd_table */
+				p->rc = di_pipe(p, (int *) buffer);
+
+                                p->state = READY_STATE;
+				ready(p);
+				break;
                 }
+
+		/* procs that gave up the cpu to wait on an event keep their level and get a fresh quantum */
+		switch(p->state) {
+			case SLEEP_STATE:
+			case BLOCK_ON_SEND_STATE:
+			case BLOCK_ON_RECV_STATE:
+			case BLOCK_ON_SIG_STATE:
+			case BLOCK_ON_DEV_STATE:
+			case BLOCK_ON_POLL_STATE:
+				p->slice = quantum(p);
+				p->waited = TRUE;
+				break;
+		}
         }
 }
 
@@ -356,64 +687,317 @@ pcb_t* get_proc(int pid)
 /*
 * next
 *
-* @desc:        pop the head of ready queue
+* @desc:        pop the earliest deadline real-time proc, otherwise the head of the highest 
+*		non-empty ready queue level
 *
 * @output:      p       current head of the ready queue
 */
 pcb_t* next ()
 {
-        pcb_t *p = ready_q;
-        if(p) ready_q = p->next;
+        int i;
+        pcb_t *p;
+
+        /* released real-time jobs always run ahead of time sharing procs */
+        p = rt_next();
+
+        for(i=0 ; i<SCHED_LEVELS && !p ; i++)
+        {
+                p = ready_q[i];
+                if(p) ready_q[i] = p->next;
+        }
+
         return p;
 }
 
 /*
 * ready
 *
-* @desc:        push pcb block to the end of ready queue
+* @desc:        push pcb block to the end of its ready queue level
+*
+* @note:        within a level, latency-sensitive procs are queued ahead of normal procs, 
+*		which are queued ahead of batch procs. a proc that is requeued without having waited
+*		on an event, e.g. on a full quantum or a syscall that does not block, is queued as a
+*		normal proc at best, so a busy latency-sensitive proc can not starve its peers. the
+*		idle proc is never queued
 */
 void ready(pcb_t *p) 
 {
-        pcb_t *tmp = ready_q;
+        pcb_t *tmp = ready_q[p->level];
+
+        /* idle proc is picked by the dispatcher only when every queue is empty */
+        if(p == idle_proc) return;
+
+        if(p->sched_class == SCHED_CLASS_RT)
+        {
+                rt_ready(p);
+                return;
+        }
 
         p->next=NULL;
 
-        if(!tmp) 
+        /* add proc to head, ahead of every proc with a weaker hint */
+        if(!tmp || sched_rank(tmp) > sched_rank(p)) 
         {
-                ready_q = p;
-                ready_q->next = NULL;
+                p->next = ready_q[p->level];
+                ready_q[p->level] = p;
                 return;
         }
 
-        while(tmp) 
+        /* add proc to body/tail, behind every proc with the same or a stronger hint */
+        while(tmp->next && sched_rank(tmp->next) <= sched_rank(p)) 
+                tmp = tmp->next;
+
+        p->next = tmp->next;
+        tmp->next = p;
+}
+
+/*
+* ready_head
+*
+* @desc:        push pcb block to the head of its ready queue level
+*
+* @note:        used for a proc that has not used up its quantum, it is dispatched again 
+*		unless a higher level proc became ready
+*/
+void ready_head(pcb_t *p) 
+{
+        if(p == idle_proc) return;
+
+        if(p->sched_class == SCHED_CLASS_RT)
         {
-                if(!tmp->next) break;
+                rt_ready(p);
+                return;
+        }
+
+        p->next = ready_q[p->level];
+        ready_q[p->level] = p;
+}
+
+/*
+* unready
+*
+* @desc:        remove pcb block from its ready queue level
+*
+* @param:       p               proc to be removed
+*
+* @output:      TRUE            proc was found and removed
+*               FALSE           proc is not on its ready queue level
+*/
+Bool unready(pcb_t *p)
+{
+        pcb_t *tmp = ready_q[p->level];
+
+        if(!tmp) return FALSE;
+        if(tmp == p)
+        {
+                ready_q[p->level] = p->next;
+                return TRUE;
+        }
+
+        while(tmp->next)
+        {
+                if(tmp->next == p)
+                {
+                        tmp->next = p->next;
+                        return TRUE;
+                }
                 tmp = tmp->next;
         }
-        tmp->next = p;
+
+        return FALSE;
+}
+
+/*
+* yield_to
+*
+* @desc:        hand the remaining quantum of a proc to another ready proc
+*
+* @param:       p               proc giving up the cpu
+*               pid             pid of the proc to run next
+*
+* @output:      SYSOK           target proc has been placed at the head of the ready queue
+*               SYSERR          target proc is the current proc, is not ready, or either proc is real-time
+*
+* @note:        the target is raised to the level of the yielding proc if it sits on a lower level, 
+*		and the yielding proc starts its next turn with a fresh quantum
+*/
+int yield_to(pcb_t *p, unsigned int pid)
+{
+        pcb_t *target = get_proc(pid);
+
+        if(!target || target == p || target == idle_proc) return SYSERR;
+        if(target->state != READY_STATE) return SYSERR;
+        if(p->sched_class == SCHED_CLASS_RT || target->sched_class == SCHED_CLASS_RT) return SYSERR;
+        if(!unready(target)) return SYSERR;
+
+        if(target->level > p->level)
+                target->level = p->level;
+
+        /* donate the rest of the quantum */
+        target->slice = p->slice;
+        p->slice = quantum(p);
+
+        ready_head(target);
+        return SYSOK;
+}
+
+/*
+* sched_hint
+*
+* @desc:        set the scheduler hint of a proc and requeue it by its new hint
+*
+* @param:       pid             pid of the proc to be hinted
+*               hint            SCHED_HINT_LATENCY, SCHED_HINT_NORMAL or SCHED_HINT_BATCH
+*
+* @output:      SYSOK           hint has been applied
+*               SYSERR          invalid pid or hint
+*
+* @note:        with SCHED_MLFQ a batch proc is moved straight to the lowest level where the 
+*		quantum is the longest
+*/
+int sched_hint(unsigned int pid, unsigned int hint)
+{
+        pcb_t *p = get_proc(pid);
+        Bool queued;
+
+        if(!p || p == idle_proc) return SYSERR;
+        if(hint != SCHED_HINT_LATENCY && hint != SCHED_HINT_NORMAL && hint != SCHED_HINT_BATCH) return SYSERR;
+
+        queued = p->state == READY_STATE && p->sched_class == SCHED_CLASS_TS && unready(p);
+
+        p->hint = hint;
+#if SCHED_POLICY == SCHED_MLFQ
+        if(hint == SCHED_HINT_BATCH)
+        {
+                p->level = SCHED_LEVELS-1;
+                p->slice = quantum(p);
+        }
+#endif
+
+        if(queued)
+                ready(p);
+
+        return SYSOK;
 }
 
 /*
 * count
 *
-* @desc:        count the number of pcb in the ready queue
+* @desc:        count the number of pcb in all ready queue levels and the rt_q
 *
 * @note:        the stop queue count is (PROC_SZ-cnt)
 */
 int count (void)
 {
-        int cnt=0;
-        pcb_t *tmp = ready_q;
+        int cnt=rt_count(),i;
+        pcb_t *tmp;
 
-        while(tmp) 
+        for(i=0 ; i<SCHED_LEVELS ; i++)
         {
-                cnt++;
-                tmp=tmp->next;
+                for(tmp = ready_q[i] ; tmp ; tmp = tmp->next) 
+                        cnt++;
         }
 
         return cnt;
 }
 
+/*
+* quantum
+*
+* @desc:        get the quantum of a proc
+*
+* @param:       p               proc to get the quantum for
+*
+* @output:      ticks           number of timer ticks the proc may run before it is preempted
+*
+* @note:        a quantum set through sysquantum() overrides the quantum of the proc level
+*/
+unsigned int quantum(pcb_t *p)
+{
+        unsigned int ticks;
+
+        if(!p->quantum_ms)
+                return sched_quantum[p->level];
+
+        /* per proc quantum is kept in ms so it follows changes to the tick rate */
+        ticks = sleep_to_slice(p->quantum_ms);
+        return ticks ? ticks : 1;
+}
+
+/*
+* boost
+*
+* @desc:        move every proc back to level 0 with a fresh quantum
+*
+* @note:        the lower ready queue levels are appended to level 0 in order, so the relative 
+*		ordering between queued procs is kept
+*/
+void boost(void)
+{
+        int i;
+        pcb_t *tmp;
+
+        for(i=0 ; i<PROC_SZ ; i++)
+        {
+                if(proc_table[i].pid == INVALID_PID) continue;
+
+                proc_table[i].level = 0;
+                proc_table[i].slice = quantum(&proc_table[i]);
+        }
+
+        for(i=1 ; i<SCHED_LEVELS ; i++)
+        {
+                if(!ready_q[i]) continue;
+
+                if(!ready_q[0]) 
+                        ready_q[0] = ready_q[i];
+                else
+                {
+                        for(tmp = ready_q[0] ; tmp->next ; tmp = tmp->next);
+                        tmp->next = ready_q[i];
+                }
+
+                ready_q[i] = NULL;
+        }
+}
+
+/*
+* sched_info
+*
+* @desc:        fill in the scheduler policy and settings as seen by a proc
+*
+* @param:       p               proc requesting the scheduler settings
+*               info            user buffer to fill in
+*
+* @output:      SYSOK           info has been filled in
+*               SYSERR          info is not memory the proc may pass in
+*/
+int sched_info(pcb_t *p, sched_info_t *info)
+{
+        int i;
+        sched_info_t s;
+
+        s.policy = SCHED_POLICY;
+#if SCHED_POLICY == SCHED_MLFQ
+        s.levels = SCHED_LEVELS;
+        s.boost = SCHED_BOOST;
+#else
+        s.levels = 1;
+        s.boost = 0;
+#endif
+        for(i=0 ; i<SCHED_LEVELS ; i++)
+                s.quantum[i] = sched_quantum[i];
+
+        s.level = p->level;
+        s.hint = p->hint;
+        s.slice = quantum(p);
+        s.hz = clock_hz;
+        s.ticks = sched_ticks;
+        s.idle_ticks = idle_ticks;
+
+        return copy_to_user(p, info, &s, sizeof(sched_info_t)) == sizeof(sched_info_t) ? SYSOK : SYSERR;
+}
+
 /*
 * stop
 *
@@ -469,13 +1053,14 @@ void release(pcb_t **q)
 */
 void puts_ready_q()
 {
-        pcb_t *tmp = ready_q;
+        int i;
+        pcb_t *tmp;
 
-        kprintf("ready_q: ");
-        while(tmp) 
+        for(i=0 ; i<SCHED_LEVELS ; i++)
         {
-                kprintf("%d ", tmp->pid);
-                tmp=tmp->next;
+                kprintf("ready_q[%d]: ", i);
+                for(tmp = ready_q[i] ; tmp ; tmp = tmp->next) 
+                        kprintf("%d(%d) ", tmp->pid, tmp->slice);
+                kprintf("\n");
         }
-        kprintf("\n");
 }
@@ -142,5 +142,6 @@ void trap(int inum)
 	kprintf("edi %08X (%u)\n", *sp, *sp); sp--;
 
 	kprintf("\nHalting.....\n");
+	klog_flush();
         for(;;);
 }
@@ -27,8 +27,6 @@
 #define	KSTACK	2
 #define	KDATA	3
 
-void enable_irq( unsigned int,  int);
-
 
 struct sd gdt_copy[NGD] = {
 		/* 0th entry NULL */
@@ -50,15 +48,96 @@ long	initsp;		/* initial SP for init() */
 long    freemem;        /* start of free memory */
 char	*maxaddr;       /* end of memory space */
 
+mem_region_t	mem_map[MEM_REGIONS];	/* usable memory, ordered by address */
+int		mem_regions = 0;
 
 
+/*------------------------------------------------------------------------
+ * mem_add - add a usable memory region, merging it with its neighbours
+ *------------------------------------------------------------------------
+ */
+static void mem_add(unsigned int start, unsigned int end)
+{
+	int i, j;
+
+	start = PG_ROUND(start);
+	end &= PG_FRAME;
+	if (end <= start)
+		return;
+
+	/* find the first region that ends at or after start */
+	for (i = 0; i < mem_regions && mem_map[i].end < start; i++)
+		;
+
+	/* overlapping or adjacent, grow region i and absorb the ones it reaches */
+	if (i < mem_regions && mem_map[i].start <= end) {
+		if (start < mem_map[i].start)
+			mem_map[i].start = start;
+		if (end > mem_map[i].end)
+			mem_map[i].end = end;
+
+		while (i+1 < mem_regions && mem_map[i+1].start <= mem_map[i].end) {
+			if (mem_map[i+1].end > mem_map[i].end)
+				mem_map[i].end = mem_map[i+1].end;
+			for (j = i+1; j < mem_regions-1; j++)
+				mem_map[j] = mem_map[j+1];
+			mem_regions--;
+		}
+		return;
+	}
+
+	if (mem_regions == MEM_REGIONS)
+		return;
+
+	for (j = mem_regions; j > i; j--)
+		mem_map[j] = mem_map[j-1];
+	mem_map[i].start = start;
+	mem_map[i].end = end;
+	mem_regions++;
+}
+
 /*------------------------------------------------------------------------
  * sizmem - return memory size (in pages)
+ *
+ * reads the e820 map stored by boot/setup.S, when there is none, or the
+ * setup that booted us did not probe it (no E820_SIG), the
+ * memory is the base 640K plus the extended memory size from int 0x15,
+ * and 4MB when neither has been stored
  *------------------------------------------------------------------------
  */
 long sizmem(void)
 {
-        return 1024;
+	struct e820	*e = (struct e820 *) E820_MAP;
+	int		n = *(unsigned char *) E820_NR;
+	unsigned int	ext = *(unsigned short *) EXT_MEM_K;
+	unsigned int	end;
+	int		i;
+
+	if (*(unsigned int *) E820_SIG != E820_SMAP)
+		n = 0;
+	if (n > E820_MAX)
+		n = E820_MAX;
+
+	for (i = 0; i < n; i++) {
+		if (e[i].type != E820_RAM || e[i].addr_hi || e[i].addr_lo >= MEM_LIMIT)
+			continue;
+
+		end = e[i].addr_lo + e[i].size_lo;
+		if (e[i].size_hi || end < e[i].addr_lo || end > MEM_LIMIT)
+			end = MEM_LIMIT;
+
+		mem_add(e[i].addr_lo, end);
+	}
+
+	if (!mem_regions) {
+		mem_add(0, HOLESTART);
+		if (ext)
+			mem_add(0x100000, 0x100000 + ext * 1024);
+		else
+			mem_add(0x100000, 0x400000);
+	}
+
+	return mem_map[mem_regions-1].end / NBPG;
 }
 
 
@@ -73,20 +152,21 @@ void setsegs(void)
 	unsigned int	np, npages;
 
 	npages = sizmem();
-	maxaddr = (char *)(npages * NBPG - 1);
+	maxaddr = (char *)(npages * NBPG - 1);	/* end of the highest usable region */
 
 	psd = &gdt_copy[1];	/* kernel code segment */
 	np = ((int)&etext + NBPG-1) / NBPG;	/* # code pages */
 	psd->sd_lolimit = np;
 	psd->sd_hilimit = np >> 16;
 
+	/* data and stack segments are flat, proc stacks live at VM_STACK_TOP once paging is on */
 	psd = &gdt_copy[2];	/* kernel data segment */
-	psd->sd_lolimit = npages;
-	psd->sd_hilimit = npages >> 16;
+	psd->sd_lolimit = 0xffff;
+	psd->sd_hilimit = 0xf;
 
 	psd = &gdt_copy[3];	/* kernel stack segment */
-	psd->sd_lolimit = npages;
-	psd->sd_hilimit = npages >> 16;
+	psd->sd_lolimit = 0xffff;
+	psd->sd_hilimit = 0xf;
 
 	psd = &gdt_copy[4];	/* bootp code segment */
 	psd->sd_lolimit = npages;   /* Allows execution of 0x100000 CODE */
@@ -47,7 +47,14 @@ extern char *maxaddr; 		/* max memory address (set in i386.c)	*/
  	int i;
 
  	kmeminit();
+ 	vm_init();
+ 	stack_cache_init();
  	kbd_init();
+	cons_init();
+	uart_init();
+	pipe_init();
+	bcache_init();
+	ram_init();
  	contextinit();
 
 	/* fill the process stop queue */
@@ -21,77 +21,72 @@
  */
 
 #include <xeroskernel.h>
+#include <xeroslib.h>
 #include <scanToASCII.h>
 #include <kbd.h>
 
 
 /* Your code goes here */
 extern devsw_t dev_table[DEV_SZ];
-static unsigned char kbd_buf[5];
-static int kbd_buf_i = 0;	
+static unsigned char kbd_ring[KBD_RING_SZ];	/* keystrokes, indexed by the free running counters below modulo KBD_RING_SZ */
+static unsigned int kbd_head = 0;		/* keystrokes written by kbd_iint() 					*/
+static unsigned int kbd_tail = 0;		/* keystrokes copied out to readers 					*/
+static unsigned int kbd_lost = 0;		/* keystrokes dropped on a full ring 					*/
 static unsigned char kbd_eof = 4;		/* init eof to enter */
-static unsigned int kbd_free = 4;
 static unsigned int kbd_echo_flag = FALSE;
 static unsigned int kbd_eof_flag = FALSE;
-pcb_t *kbd_q = NULL;
 
-typedef struct kbdi kbdi_t;		/* kbd queue interface */
+typedef struct kbdi kbdi_t;		/* kbd queue interface, one per queued read */
 struct kbdi 
 {
-	devsw_t* d;
+	pcb_t* p;			/* proc that queued the read 			*/
+	fd_t* f;			/* fd the read was queued on 			*/
 	void* buf;
 	int buflen;
 	int bufi;
+	kbdi_t* next;
 };
 
+static kbdi_t *kbd_q = NULL;
+
 /*
 * kbd_enqueue
 *
-* @desc:	place proc on device queue
+* @desc:	place a read at the tail of the device queue
 *
-* @param:	p	proc to be placed on queue
+* @param:	k	read to be placed on queue
 *
 * @note:	this is an upper layer function
 */
-void kbd_enqueue(pcb_t *p)
+static void kbd_enqueue(kbdi_t *k)
 {
-	pcb_t* tmp=kbd_q;
-	p->next = NULL;
-
-	if(!kbd_q)
-		kbd_q = p;
+	kbdi_t **q;
 
-	while(tmp)
-	{
-		if(!(tmp->next))
-			break;
-		tmp=tmp->next;
-	}
-
-	tmp->next = p;
+	k->next = NULL;
+	for(q = &kbd_q ; *q ; q = &((*q)->next));
+	*q = k;
 }
 
 /*
 * kbd_dequeue
 *
-* @desc:	places head queue proc back on ready_q
+* @desc:	completes the head queue read, a blocked proc is placed back on ready_q
 *
 * @note:	this is an upper layer function
 */
 void kbd_dequeue()
 {
-	pcb_t* p = NULL;
+	kbdi_t* k = kbd_q;
 
-	if(kbd_q)
+	if(k)
 	{
+		kbd_q = k->next;
+
 		/* set proc rc as 0 for eof */
-		if(kbd_eof_flag)
-			p->rc = 0;
+		di_complete(k->p, k->f, kbd_eof_flag ? 0 : k->bufi);
 
-		p = kbd_q;
-		kbd_q = kbd_q->next;
-		p->state = READY_STATE;
-		ready(p);
+		/* release the kbd queue interface built by kbd_read() */
+		kfree(k);
 	}
 }
 
@@ -102,64 +97,46 @@ void kbd_dequeue()
 */
 void puts_kbd_q()
 {
-	pcb_t *tmp = kbd_q;
+	kbdi_t *tmp = kbd_q;
 
 	kprintf("kbd_q: ");
         while(tmp) 
         {                  
-		kprintf("%d ", tmp->pid);     
+		kprintf("%d ", tmp->p->pid);     
                 tmp = tmp->next;
         }
+	kprintf("(%d keys buffered, %d lost)\n", kbd_head - kbd_tail, kbd_lost);
 }
 
 
 /*
 * kbd_init
 *
-* @desc:	initialize echo and non-echo keyboard entries in the dev_table
+* @desc:	register the echo and non-echo keyboard devices
 *
-* @note:	for unsupported calls, kbd_error is supplied
+* @note:	both devices share the keyboard, kbd_open lets only one of them be open at a time.
 *		for dvwrite, a kbd_write function is supplied, however this call also always returns -1	
 */
 void kbd_init()
 {
+	devsw_t d;
+
+	memset(&d, 0, sizeof(devsw_t));
+	d.dvopen   	= kbd_open;
+	d.dvclose  	= kbd_close;
+	d.dvread   	= kbd_read;
+	d.dvwrite  	= kbd_write;
+	d.dvcntl   	= kbd_ioctl;
+	d.dvcancel   	= kbd_cancel;
+	d.dvpoll   	= kbd_poll;
+
 	/* init non-echo kbd */
-	dev_table[KBD_NECHO].dvowner  	= 0;
-	dev_table[KBD_NECHO].dvnum    	= KBD_NECHO;
-	dev_table[KBD_NECHO].dvinit    	= kbd_error;
-	dev_table[KBD_NECHO].dvopen   	= kbd_open;
-	dev_table[KBD_NECHO].dvclose  	= kbd_close;
-	dev_table[KBD_NECHO].dvread   	= kbd_read;
-	dev_table[KBD_NECHO].dvwrite  	= kbd_write;
-	dev_table[KBD_NECHO].dvseek  	= kbd_error;
-	dev_table[KBD_NECHO].dvgetc  	= kbd_error;
-	dev_table[KBD_NECHO].dvputc  	= kbd_error;
-	dev_table[KBD_NECHO].dvcntl   	= kbd_ioctl;
-	dev_table[KBD_NECHO].dvcsr   	= NULL;
-	dev_table[KBD_NECHO].dvivec   	= NULL;
-	dev_table[KBD_NECHO].dvovec   	= NULL;
-	dev_table[KBD_NECHO].dviint   	= kbd_error;
-	dev_table[KBD_NECHO].dvoint   	= kbd_error;
-	dev_table[KBD_NECHO].dvioblk   	= NULL;	
+	d.dvnum    	= KBD_NECHO;
+	di_register(&d);
 
 	/* init echo kbd */
-	dev_table[KBD_ECHO].dvowner  	= 0;
-	dev_table[KBD_ECHO].dvnum    	= KBD_ECHO;
-	dev_table[KBD_ECHO].dvinit    	= kbd_error;
-	dev_table[KBD_ECHO].dvopen   	= kbd_open;
-	dev_table[KBD_ECHO].dvclose  	= kbd_close;
-	dev_table[KBD_ECHO].dvread   	= kbd_read;
-	dev_table[KBD_ECHO].dvwrite  	= kbd_write;
-	dev_table[KBD_ECHO].dvseek  	= kbd_error;
-	dev_table[KBD_ECHO].dvgetc  	= kbd_error;
-	dev_table[KBD_ECHO].dvputc  	= kbd_error;
-	dev_table[KBD_ECHO].dvcntl   	= kbd_ioctl;
-	dev_table[KBD_ECHO].dvcsr   	= NULL;
-	dev_table[KBD_ECHO].dvivec   	= NULL;
-	dev_table[KBD_ECHO].dvovec   	= NULL;
-	dev_table[KBD_ECHO].dviint   	= kbd_error;
-	dev_table[KBD_ECHO].dvoint   	= kbd_error;
-	dev_table[KBD_ECHO].dvioblk   	= NULL;
+	d.dvnum    	= KBD_ECHO;
+	di_register(&d);
 }
 
 /*
@@ -167,21 +144,19 @@ void kbd_init()
 *
 * @desc:	enables the keyboard hardware interrupt
 *		
-* @output:	rc		returns 0 on successful device open
+* @output:	rc		returns 0 on successful device open, -1 while the other kbd device is open
 */
-int kbd_open(devsw_t* d)
+int kbd_open(devsw_t* d, fd_t *f)
 {
-	int i;
+	/* only 1 kbd device can be opened, echo/non-echo */
+	if(dev_table[d->dvnum == KBD_ECHO ? KBD_NECHO : KBD_ECHO].dvopens)
+		return DEV_ERR;
 
 	/* enable keyboard hardware device */
 	enable_irq(1,0);
 
 	/* enable echo */
-	for(i=0 ; i<DEV_SZ ; i++)
-	{
-		if(dev_table[i].dvowner && i == KBD_ECHO)
-			kbd_echo_flag = TRUE;
-	}
+	kbd_echo_flag = d->dvnum == KBD_ECHO;
 
 	return DEV_SUCCESS;
 }
@@ -193,11 +168,14 @@ int kbd_open(devsw_t* d)
 *		
 * @output:	rc		returns 0 on successful device close
 */
-int kbd_close(devsw_t* d)
+int kbd_close(devsw_t* d, fd_t *f)
 {
 	kbd_echo_flag = FALSE;
 	kbd_eof_flag = FALSE;
 
+	/* typed-ahead keystrokes do not outlive the device */
+	kbd_tail = kbd_head;
+
 	/* disable keyboard hardware device */
 	enable_irq(1,1);
 	return DEV_SUCCESS;
@@ -210,7 +188,7 @@ int kbd_close(devsw_t* d)
 *
 * @output:	rc		always returns -1
 */
-int kbd_write(devsw_t* d, void* buf, int buflen)
+int kbd_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen)
 {
 	return DEV_ERR;
 }
@@ -222,39 +200,56 @@ int kbd_write(devsw_t* d, void* buf, int buflen)
 *
 * @param:	p		proc to be placed on kbd_q
 *		d
+*		f
 *		buf		user buffer
 *		buflen		user buffer length
 *
-* @output:	rc		returns 0 on successful enqueuing
+* @output:	rc		returns 0 on successful enqueuing, -1 when buf is not memory the proc may pass in,
+*				BLOCKERR when f is O_NONBLOCK and no keystroke is waiting
 *
-* @note:	this is an upper layer function
+* @note:	this is an upper layer function, the read is completed before returning when the ring already holds
+*		a full line or enough keystrokes to fill buf. an O_NONBLOCK read completes with the keystrokes waiting
 */
-int kbd_read(pcb_t *p, devsw_t* d, void* buf, int buflen)
+int kbd_read(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen)
 {
 	int *mem = NULL;
 	kbdi_t *k = NULL;
 
+	/* keystrokes are copied into buf long after this call, it must be memory the proc may pass in */
+	if(clear_user(p, buf, buflen) != buflen)
+		return -1;
 
 	/* eof flag has been toggled, return proc immediately */
 	if(kbd_eof_flag)
 	{
-		p->rc = 0;
-		p->state = READY_STATE;
-		ready(p);
+		di_complete(p, f, 0);
+		return DEV_SUCCESS;
 	}	
 
+	/* reads queued ahead of this one take the waiting keystrokes first */
+	if(f->flags & O_NONBLOCK && (kbd_q || kbd_tail == kbd_head))
+		return BLOCKERR;
+
 	/* build kbd_q */
 	mem = kmalloc(sizeof(kbdi_t));
+	if(!mem)
+		return -1;
         k = (kbdi_t *) ((int)mem); 
 
-	strncpy((unsigned char*)buf, "", buflen);
-	k->d = d;
+	k->p = p;
+	k->f = f;
 	k->buf = buf;
 	k->buflen = buflen;
 	k->bufi = 0;
 
-	p->ptr = k;	
-	kbd_enqueue(p);
+	kbd_enqueue(k);
+
+	/* hand over keystrokes typed ahead of the read, which may complete it right away */
+	kbd_notify();
+
+	/* a non-blocking read takes what has been typed so far */
+	if(f->flags & O_NONBLOCK && kbd_q == k)
+		kbd_dequeue();
 
 	return DEV_SUCCESS;
 }
@@ -264,69 +259,119 @@ int kbd_read(pcb_t *p, devsw_t* d, void* buf, int buflen)
 *
 * @desc:	updates the eof character for keyboard input
 *
-* @param:	eof		new eof character
+* @param:	command		SET_EOF, the only command supported
+*		eof		new eof character
 *		
-* @output:	rc		returns 0 on successful update
+* @output:	rc		returns 0 on successful update, -1 for any other command or a non ascii eof
 *
 * @note:	this is an upper layer function
 */
-int kbd_ioctl(int eof)
+int kbd_ioctl(devsw_t* d, fd_t *f, unsigned long command, int eof)
 {
+	/* check for invalid command that is not SET_OEF */
+	if(command != SET_EOF) 
+		return DEV_ERR;
+
+	/* check for invalid eof ascii character */
+	if(eof < 0 || eof > 127)
+		return DEV_ERR;
+
 	kbd_eof = eof;
 	return DEV_SUCCESS;
 }
 
 /*
-* kbd_notify
+* kbd_cancel
+*
+* @desc:	takes the reads of proc off kbd_q, the reads are abandoned
 *
-* @desc:	copies device internal buffer data into user buffer
+* @param:	d
+*		p		proc whose reads are taken off
+*		f		fd whose reads are taken off, NULL for the read proc is blocked on, which readies proc
 *
 * @note:	this is an upper layer function
 */
-void kbd_notify()
+int kbd_cancel(devsw_t* d, pcb_t *p, fd_t *f)
 {
-	unsigned char *buf;
-	unsigned char tmp[5];			/* temporary holder of character to concatenated onto the end of the user buffer */
-	kbdi_t* k = NULL;
-	pcb_t* p = NULL;
+	kbdi_t **q = &kbd_q;
+	kbdi_t *k;
 
-	int i=kbd_buf_i;
-	strncpy(tmp, "", 5);
-
-	/* only transfer characters if a proc has been blocked on device */
-	if(kbd_q)
+	while((k = *q))
 	{
-		k = (kbdi_t*) kbd_q->ptr;
-		buf = (unsigned char *) k->buf;
-
-		/* copy character from internal buffer to user buffer */
-		if( kbd_buf_i > k->buflen) 
+		if(k->p != p || (f ? k->f != f : k->f->flags & O_ASYNC))
 		{
-			strncpy(tmp, kbd_buf, k->buflen ); 
-			kbd_free += k->buflen;
-			strncat(buf, tmp, k->buflen);
+			q = &(k->next);
+			continue;
 		}
-		else
+
+		*q = k->next;
+		kfree(k);
+
+		if(!f)
 		{
-			strncpy(tmp, kbd_buf, kbd_buf_i); 
-			strcat(buf, tmp);
-			kbd_free += kbd_buf_i;
+			p->state = READY_STATE;
+			ready(p);
 		}
+	}
 
-		k->bufi += kbd_buf_i;
-		kbd_buf_i = 0;
+	return DEV_SUCCESS;
+}
+
+/*
+* kbd_poll
+*
+* @desc:	the keyboard is ready for reading once a keystroke is waiting or eof has been typed
+*
+* @output:	revents		POLLIN when a read would not block
+*/
+int kbd_poll(devsw_t* d, fd_t *f, unsigned int events)
+{
+	return kbd_eof_flag || (!kbd_q && kbd_tail != kbd_head) ? POLLIN : 0;
+}
+
+/*
+* kbd_notify
+*
+* @desc:	drains the keystroke ring into the buffers of the queued readers
+*
+* @note:	this is an upper layer function. each reader takes keystrokes up to and including the first enter, or
+*		as many as fit in its buffer, with at most two bounded copies since the run may wrap around the ring.
+*		keystrokes left over stay in the ring for the next reader
+*/
+void kbd_notify()
+{
+	kbdi_t* k = NULL;
+	unsigned int n, first, start;
+	Bool eol;
+
+	/* only transfer characters if a read has been queued on device */
+	while(kbd_q && kbd_tail != kbd_head)
+	{
+		k = kbd_q;
+
+		/* find the run of keystrokes for the head reader */
+		eol = FALSE;
+		for(n=0 ; kbd_tail + n != kbd_head && n < k->buflen - k->bufi && !eol ; n++)
+			eol = kbd_ring[(kbd_tail + n) & KBD_RING_MASK] == ENTER_KEY;
+
+		/* append the run to the end of the user buffer, the reading proc may not be running hence its
+		 * buffer is copied into through its address space 
+		 */
+		start = kbd_tail & KBD_RING_MASK;
+		first = n < KBD_RING_SZ - start ? n : KBD_RING_SZ - start;
+		vm_copy(k->p, (unsigned char *) k->buf + k->bufi, NULL, &kbd_ring[start], first);
+		if(n > first)
+			vm_copy(k->p, (unsigned char *) k->buf + k->bufi + first, NULL, kbd_ring, n - first);
+
+		k->bufi += n;
+		kbd_tail += n;
 
 		/* return to user process if enter is pressed */
 		/* return process if user buffer is full */
-		if(kbd_buf[i-1] == ENTER_KEY || k->bufi >= k->buflen)
-		{
-			if(k->bufi > k->buflen)
-				kbd_q->rc = k->buflen;
-			else
-				kbd_q->rc = k->bufi;
+		if(!eol && k->bufi < k->buflen)
+			break;
 
-			kbd_dequeue();
-		}
+		kbd_dequeue();
 	}
 }
 
@@ -335,7 +380,8 @@ void kbd_notify()
 *
 * @desc:	handles keyboard device interrupts
 *
-* @note:	this is a lower layer function
+* @note:	this is a lower layer function, a keystroke is put in the ring in constant time and only dropped 
+*		when KBD_RING_SZ keystrokes are waiting for a reader
 */
 int kbd_iint()
 {
@@ -349,13 +395,13 @@ int kbd_iint()
 			kprintf("%c\n", key);
 
 
-		/* copy typed characters to internal buffer */
-		if(key != 0 && key != kbd_eof && kbd_free > 0)
+		/* copy typed characters to the ring */
+		if(key != 0 && key != kbd_eof)
 		{
-			kbd_buf[kbd_buf_i] = key;
-			kbd_buf_i++;
-			kbd_free--;
-			//kprintf("i: %d	free: %d\n", kbd_buf_i, kbd_free);
+			if(kbd_head - kbd_tail < KBD_RING_SZ)
+				kbd_ring[kbd_head++ & KBD_RING_MASK] = key;
+			else
+				kbd_lost++;
 		}	
 
 		/* ctrl+d pressed */
@@ -372,21 +418,15 @@ int kbd_iint()
 		/* notify the upper kbd layer that a new character has arrived */
 		if(key != 0 && !kbd_eof_flag)
 			kbd_notify();	
+
+		/* recheck procs polling the keyboard */
+		if(key != 0)
+		{
+			di_wake(&(dev_table[KBD_NECHO]));
+			di_wake(&(dev_table[KBD_ECHO]));
+		}
 	}
 
 	return DEV_SUCCESS;
 }
 
-
-/*
-* kbd_error
-*
-* @desc:	returns SYSERR for any function not implemented for device
-*
-* @output:	DEV_ERR
-*/
-int kbd_error()
-{
-	kprintf("device function not supported\n");
-	return DEV_ERR;
-}
@@ -0,0 +1,290 @@
+/* Kernel Log
+ *
+ * This is the kernel log unit, kprintf() appends its output to a ring of
+ * text records, each line prefixed with "<level>[ticks] ". The ring is
+ * drained to the screen a batch at a time on every timer tick, and read in
+ * bulk by procs through syslogread(). When the ring is full the oldest
+ * records are overwritten.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+
+#define KLOG_MASK	(KLOG_SZ - 1)
+
+/* screen drain state, the record header is parsed for its level and is not shown */
+#define KS_SYNC		0		/* skipping the rest of an overwritten record 	*/
+#define KS_OPEN		1		/* expecting '<' 				*/
+#define KS_LEVEL	2		/* expecting the level digit 			*/
+#define KS_STAMP	3		/* skipping up to the ' ' after the timestamp 	*/
+#define KS_TEXT		4
+
+static unsigned char klog_ring[KLOG_SZ];	/* records, indexed by the free running counters below modulo KLOG_SZ 	*/
+static unsigned int klog_head = 0;		/* bytes appended 							*/
+static unsigned int klog_shown = 0;		/* bytes drained to the screen 						*/
+static unsigned int klog_rd = 0;		/* bytes taken by klog_read() 						*/
+static unsigned int klog_time = 0;		/* timer ticks since the log was started 				*/
+static unsigned int klog_lost = 0;		/* unread bytes overwritten 						*/
+static Bool klog_bol = TRUE;			/* next byte starts a record 						*/
+static int klog_state = KS_OPEN;
+static Bool klog_show = TRUE;			/* current record is shown on screen 					*/
+
+
+/*
+* klog_cli
+*
+* @desc:	disable interrupts, procs call kprintf() directly and may be preempted by the kernel appending too
+*
+* @output:	flags		eflags to be restored with klog_sti()
+*/
+static unsigned int klog_cli(void)
+{
+	unsigned int flags;
+
+	__asm __volatile("pushfl ; popl %0 ; cli" : "=r" (flags));
+	return flags;
+}
+
+static void klog_sti(unsigned int flags)
+{
+	__asm __volatile("pushl %0 ; popfl" : : "r" (flags));
+}
+
+/*
+* klog_put
+*
+* @desc:	append a byte to the ring, overwriting the oldest byte when the ring is full
+*/
+static void klog_put(unsigned char c)
+{
+	klog_ring[klog_head++ & KLOG_MASK] = c;
+}
+
+/*
+* klog_header
+*
+* @desc:	append the "<level>[ticks] " record header
+*/
+static void klog_header(int level)
+{
+	char digits[10];
+	unsigned int t = klog_time;
+	int i = 0;
+
+	do
+	{
+		digits[i++] = '0' + t % 10;
+		t /= 10;
+	} while(t);
+
+	klog_put('<');
+	klog_put('0' + level);
+	klog_put('>');
+	klog_put('[');
+	while(i)
+		klog_put(digits[--i]);
+	klog_put(']');
+	klog_put(' ');
+}
+
+/*
+* klog_write
+*
+* @desc:	append text to the log, every line of it starts a new record of the given level
+*
+* @param:	level		record level, KLOG_ERR .. KLOG_DEBUG
+*		buf		text
+*		len		text length
+*
+* @note:	appending is bounded by len and never waits for the screen
+*/
+void klog_write(int level, char *buf, int len)
+{
+	unsigned int flags = klog_cli();
+
+	while(len-- > 0)
+	{
+		if(klog_bol)
+			klog_header(level);
+
+		klog_put(*buf);
+		klog_bol = *buf++ == '\n';
+	}
+
+	klog_sti(flags);
+}
+
+/*
+* klog_resync
+*
+* @desc:	move a reader that has been overrun to the start of the oldest whole record
+*
+* @output:	pos		new reader position
+*/
+static unsigned int klog_resync(unsigned int pos)
+{
+	if(klog_head - pos <= KLOG_SZ)
+		return pos;
+
+	pos = klog_head - KLOG_SZ;
+	while(pos != klog_head && klog_ring[pos++ & KLOG_MASK] != '\n');
+
+	return pos;
+}
+
+/*
+* klog_drain
+*
+* @desc:	write up to max log bytes to the screen, headers and records above KLOG_CONSOLE_LEVEL are left out
+*/
+static void klog_drain(unsigned int max)
+{
+	unsigned char out[KLOG_BATCH];
+	unsigned char c;
+	unsigned int n = 0;
+
+	if(klog_head - klog_shown > KLOG_SZ)
+	{
+		klog_shown = klog_resync(klog_shown);
+		klog_state = KS_OPEN;
+	}
+
+	while(max-- && klog_shown != klog_head)
+	{
+		c = klog_ring[klog_shown++ & KLOG_MASK];
+
+		switch(klog_state)
+		{
+			case KS_SYNC:
+				if(c == '\n')
+					klog_state = KS_OPEN;
+				break;
+
+			case KS_OPEN:
+				klog_state = c == '<' ? KS_LEVEL : KS_SYNC;
+				break;
+
+			case KS_LEVEL:
+				klog_show = c - '0' <= KLOG_CONSOLE_LEVEL;
+				klog_state = KS_STAMP;
+				break;
+
+			case KS_STAMP:
+				if(c == ' ')
+					klog_state = KS_TEXT;
+				break;
+
+			case KS_TEXT:
+				if(klog_show)
+					out[n++] = c;
+				if(n == KLOG_BATCH)
+				{
+					kbmwrite(out, n);
+					n = 0;
+				}
+				if(c == '\n')
+					klog_state = KS_OPEN;
+				break;
+		}
+	}
+
+	if(n)
+		kbmwrite(out, n);
+}
+
+/*
+* klog_tick
+*
+* @desc:	advance the log clock and drain a batch of the log to the screen
+*
+* @note:	the batch is bounded by KLOG_BATCH so a long log does not stall the timer interrupt
+*/
+void klog_tick(void)
+{
+	klog_time++;
+	klog_drain(KLOG_BATCH);
+}
+
+/*
+* klog_flush
+*
+* @desc:	drain the whole log to the screen
+*
+* @note:	used before the kernel halts, when no timer tick is coming, and ahead of console device writes so
+*		they do not overtake earlier kprintf() output
+*/
+void klog_flush(void)
+{
+	klog_drain(KLOG_SZ);
+}
+
+/*
+* klog_read
+*
+* @desc:	copy the oldest unread records, with their headers, into a proc buffer
+*
+* @param:	p		proc reading the log
+*		buf		user buffer
+*		len		user buffer length
+*
+* @output:	cnt		number of bytes copied, ending on a record boundary unless a single record does not
+*				fit in buf, 0 when there is nothing unread, SYSERR when buf is not memory the proc may
+*				pass in
+*
+* @note:	records overwritten before they were read are dropped and counted as lost
+*/
+int klog_read(pcb_t *p, void *buf, int len)
+{
+	unsigned int n, start, end, first;
+
+	if(len <= 0 || !validate_range(p, buf, len))
+		return SYSERR;
+
+	start = klog_resync(klog_rd);
+	klog_lost += start - klog_rd;
+	klog_rd = start;
+
+	n = klog_head - klog_rd;
+	if(n > len)
+	{
+		/* stop after the last whole record that fits */
+		for(end = klog_rd + len ; end != klog_rd && klog_ring[(end - 1) & KLOG_MASK] != '\n' ; end--);
+		n = end != klog_rd ? end - klog_rd : len;
+	}
+
+	start = klog_rd & KLOG_MASK;
+	first = n < KLOG_SZ - start ? n : KLOG_SZ - start;
+	copy_to_user(p, buf, &klog_ring[start], first);
+	if(n > first)
+		copy_to_user(p, (unsigned char *) buf + first, klog_ring, n - first);
+
+	klog_rd += n;
+	return n;
+}
+
+/*
+* puts_klog
+*
+* @desc:	output the log fill and the unread bytes lost to overwriting
+*/
+void puts_klog()
+{
+	kprintf("klog: %d bytes, %d unread, %d not shown, %d lost\n",
+		klog_head < KLOG_SZ ? klog_head : KLOG_SZ, klog_head - klog_rd, klog_head - klog_shown, klog_lost);
+}
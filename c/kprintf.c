@@ -42,22 +42,55 @@
 #include <stdarg.h>
 
 static  void	kputc(int, unsigned char);
+static	void	kbmcursor(void);
+
+struct kline {
+	int	level;
+	int	len;
+	char	buf[KLOG_LINE];
+};
+
+static int kvlog(int level, char *fmt, va_list ap);
 
 
 /*------------------------------------------------------------------------
- *  kprintf  --  kernel printf: formatted, unbuffered output to CONSOLE
+ *  kprintf  --  kernel printf: formatted output to the kernel log, it
+ *		 reaches CONSOLE with the next timer tick, see klog.c.
+ *		 pending console device output is flushed first, and
+ *		 cons_write() drains the log first, so the two stay in order
  *------------------------------------------------------------------------
  */
 int kprintf(char * fmt, ...)
 {
-  //	unsigned int	saveof;
+  va_list ap;
+  va_start(ap, fmt);
+
+  return kvlog(KLOG_INFO, fmt, ap);
+}
 
+/*------------------------------------------------------------------------
+ *  klog  --  kprintf with a record level other than KLOG_INFO
+ *------------------------------------------------------------------------
+ */
+int klog(int level, char * fmt, ...)
+{
   va_list ap;
   va_start(ap, fmt);
-  
-    //  _doprnt(fmt, &args, kputc, 0);
 
-    _doprnt(fmt, (void *) ap,  kputc, 0);
+  return kvlog(level, fmt, ap);
+}
+
+static int kvlog(int level, char *fmt, va_list ap)
+{
+  struct kline line;
+
+  line.level = level;
+  line.len = 0;
+  _doprnt(fmt, (void *) ap, kputc, (int) &line);
+
+  /* console device output written before this record goes to the screen before it */
+  cons_flush();
+  klog_write(level, line.buf, line.len);
   return 1;
 }
 
@@ -68,9 +101,17 @@ int kprintf(char * fmt, ...)
 #define MONO_BUF	0xB0000
 #define CGA_BASE	0x3D4
 #define CGA_BUF		0xB8000
+#ifndef CGA_VRAM
+#define CGA_VRAM	0x8000		/* text memory behind CGA_BUF, the screen scrolls within it */
+#endif
+#define MONO_VRAM	(COL*ROW*CHR)	/* no spare text memory, every scroll copies */
 
 static unsigned char	att = 0x7;
 unsigned char *Crtat = (unsigned char *)CGA_BUF;
+static unsigned char	*crtat = 0;
+static unsigned char	*crtorg = 0;		/* first character shown on screen */
+static unsigned char	*crtend = 0;		/* first byte past the text memory */
+static unsigned char	*crtshown = 0;		/* crtorg as last loaded into the 6845 */
 
 static unsigned int addr_6845 = CGA_BASE;
 static void cursor(int pos)
@@ -81,8 +122,17 @@ static void cursor(int pos)
 	outb(addr_6845+1,pos&0xff);
 }
 
+static void origin(int pos)
+{
+	outb(addr_6845,12);
+	outb(addr_6845+1,pos >> 8);
+	outb(addr_6845,13);
+	outb(addr_6845+1,pos&0xff);
+}
+
 /*------------------------------------------------------------------------
- *  kbmputc - write one character to the physical monitor
+ *  kbmputc - write one character to the physical monitor, the hardware
+ *	      cursor is left alone, see kbmcursor()
  *------------------------------------------------------------------------
  */
 static void kbmputc( unsigned char c )
@@ -90,7 +140,6 @@ static void kbmputc( unsigned char c )
 	unsigned		cursorat;
 	unsigned short		was;
 	unsigned char		*cp;
-	static unsigned char	*crtat = 0;
 
 	if (c == 0)
 		return;
@@ -100,12 +149,18 @@ static void kbmputc( unsigned char c )
 		/* XXX probe to find if a color or monochrome display */
 		was = *(unsigned short *)Crtat;
 		*(unsigned short *)Crtat = 0xA55A;
+		crtend = Crtat + CGA_VRAM;
 		if (*(unsigned short *)Crtat != 0xA55A) {
 			Crtat = (unsigned char *) MONO_BUF;
+			crtend = Crtat + MONO_VRAM;
 			addr_6845 = MONO_BASE;
 		}
 		*(unsigned short *)Crtat = was;
 
+		/* show the display from the start of text memory */
+		crtorg = crtshown = Crtat;
+		origin(0);
+
 		/* Extract cursor location */
 		outb(addr_6845,14);
 		cursorat = inb(addr_6845+1)<<8 ;
@@ -151,26 +206,66 @@ static void kbmputc( unsigned char c )
 	}
 
 	/* implement a scroll */
-	if (crtat >= Crtat+COL*ROW*CHR) {
-		/* move text up */
-		blkcopy(Crtat, Crtat+COL*CHR, COL*(ROW-1)*CHR);
+	if (crtat >= crtorg+COL*ROW*CHR) {
+		if (crtorg+(ROW+1)*COL*CHR <= crtend) {
+			/* show one more line of text memory */
+			crtorg += COL*CHR;
+		} else {
+			/* out of text memory, move the screen back to the start */
+			blkcopy(Crtat, crtorg+COL*CHR, COL*(ROW-1)*CHR);
+			crtat -= crtorg+COL*CHR - Crtat;
+			crtorg = Crtat;
+		}
 
 		/* clear line */
-		for (cp = Crtat+ COL*(ROW-1)*CHR;
-			cp < Crtat + COL*ROW*CHR ; cp += 2)
+		for (cp = crtorg+ COL*(ROW-1)*CHR;
+			cp < crtorg + COL*ROW*CHR ; cp += 2) {
 			cp[0] = ' ';
-
-		crtat -= COL*CHR ;
+			cp[1] = att;
+		}
 	}
+}
 
+/*------------------------------------------------------------------------
+ *  kbmcursor - move the hardware cursor to the current position and the
+ *		display start to the scrolled origin, these take four port
+ *		writes each, so they are done once per batch
+ *------------------------------------------------------------------------
+ */
+static void kbmcursor(void)
+{
+	if (crtat == 0)
+		return;
+	if (crtorg != crtshown) {
+		origin((crtorg-Crtat)/CHR);
+		crtshown = crtorg;
+	}
 	cursor((crtat-Crtat)/CHR);
 }
 
 /*------------------------------------------------------------------------
- * kputc - do a synchronous kernel write to the console tty
+ *  kbmwrite - write a batch of characters to the physical monitor
+ *------------------------------------------------------------------------
+ */
+void kbmwrite(unsigned char *buf, int len)
+{
+	while (len-- > 0)
+		kbmputc(*buf++);
+	kbmcursor();
+}
+
+/*------------------------------------------------------------------------
+ * kputc - collect formatted output in a kline, a full kline is appended
+ *	   to the kernel log and reused
  *------------------------------------------------------------------------
  */
 static void kputc(int dev, unsigned char c)
 {
-	kbmputc(c);
+	struct kline *line = (struct kline *) dev;
+
+	if (line->len == KLOG_LINE) {
+		klog_write(line->level, line->buf, line->len);
+		line->len = 0;
+	}
+	line->buf[line->len++] = c;
 }
@@ -26,39 +26,271 @@
 #include <i386.h>
 #define PARAGRAPH_MASK 	(~(0xf))
 #define PARAGRAPH_SIZE	0x10
-#define SANITY_CHECK	0xff
+#define SANITY_CHECK	0xff		/* sanityCheck of an allocated block 		*/
+#define FREE_CHECK	0xfe		/* sanityCheck of a free block 			*/
+#define FENCE_CHECK	0xfd		/* sanityCheck of a region fence 		*/
+#define MIN_BLOCK	(sizeof(memHeader_t) + PARAGRAPH_SIZE)	/* smallest block, header and footer included */
 
 extern long freemem;
 memHeader_t *memSlot;
 
+static mem_region_t heap_map[MEM_REGIONS+2];	/* heap regions, a usable region may be split by the reserved ranges */
+static int heap_regions = 0;
+
+static memHeader_t mem_fence = { 0, NULL, NULL, (char*)FENCE_CHECK };	/* neighbour of the first block of every region */
+
+/* boundary tags, the footer in the last word of a block points back at its header */
+#define kmemfooter(slot)	((memHeader_t **) ((int)(slot) + sizeof(memHeader_t) + (slot)->size) - 1)
+#define kmemtag(slot)		(*kmemfooter(slot) = (slot))
+#define kmemnext(slot)		((memHeader_t *) ((int)(slot) + sizeof(memHeader_t) + (slot)->size))
+#define kmemprev(slot)		(*((memHeader_t **) (slot) - 1))
+
+/*
+* kmemunlink
+*
+* @desc:	take a free block off the memory list
+*/
+static void kmemunlink(memHeader_t *slot)
+{
+	if(slot->prev)
+		slot->prev->next = slot->next;
+	else
+		memSlot = slot->next;
+
+	if(slot->next)
+		slot->next->prev = slot->prev;
+}
+
+/*
+* kmemreplace
+*
+* @desc:	put a free block in the memory list position of another
+*/
+static void kmemreplace(memHeader_t *old, memHeader_t *slot)
+{
+	slot->prev = old->prev;
+	slot->next = old->next;
+
+	if(slot->prev)
+		slot->prev->next = slot;
+	else
+		memSlot = slot;
+
+	if(slot->next)
+		slot->next->prev = slot;
+}
+
+static kmem_stats_t kmem;			/* allocator counters, the free list fields are filled in on request 	*/
+#if KMEM_TRACE_SZ
+static kmem_trace_t kmem_ring[KMEM_TRACE_SZ];	/* latest kmalloc/kfree records while tracing 		*/
+static unsigned int kmem_ring_i = 0;		/* records written since tracing started 			*/
+#endif
+static Bool kmem_tracing = FALSE;
+
+/*
+* kmem_class
+*
+* @desc:	get the stats size class of size, class i holds [16 << i, 32 << i) and the last class is open ended
+*/
+static int kmem_class(unsigned int size)
+{
+	int i = 0;
+
+	while(i < KMEM_CLASSES-1 && (32 << i) <= size)
+		i++;
+
+	return i;
+}
+
+/*
+* kmem_log
+*
+* @desc:	account a kmalloc or kfree in the allocator counters, and record it while tracing
+*
+* @param:	op		KMEM_ALLOC or KMEM_FREE
+*		ptr		block address, NULL for a failed kmalloc
+*		size		block size, headers and page rounding included
+*		req		requested size
+*		caller		return address into the caller
+*/
+static void kmem_log(unsigned int op, void *ptr, unsigned int size, unsigned int req, void *caller)
+{
+#if KMEM_TRACE_SZ
+	kmem_trace_t *t;
+#endif
+
+	if(op == KMEM_ALLOC && !ptr)
+		kmem.failures++;
+	else if(op == KMEM_ALLOC)
+	{
+		kmem.allocs++;
+		kmem.classes[kmem_class(req)]++;
+		kmem.in_use += size;
+		if(kmem.in_use > kmem.peak)
+			kmem.peak = kmem.in_use;
+	}
+	else
+	{
+		kmem.frees++;
+		kmem.in_use -= size;
+	}
+
+#if KMEM_TRACE_SZ
+	if(!kmem_tracing) return;
+
+	t = &kmem_ring[kmem_ring_i++ % KMEM_TRACE_SZ];
+	t->op = op;
+	t->ptr = ptr;
+	t->size = req;
+	t->caller = caller;
+#endif
+}
+
+/*
+* kmemadd
+*
+* @desc:	append the range [start, end) as a free block at the tail of the memory list
+*
+* @param:	start		start of the range
+*		end		end of the range
+*		tail		current tail of the memory list
+*
+* @output:	tail		new tail of the memory list
+*
+* @note:	the block is fenced by a footer pointing at mem_fence right before it, and a fence header at the
+*		end of the range, so kfree never coaleses across the bounds of a region
+*/
+static memHeader_t *kmemadd(unsigned int start, unsigned int end, memHeader_t *tail)
+{
+	memHeader_t *slot, *fence;
+
+	start = (start + (int)PARAGRAPH_SIZE) & PARAGRAPH_MASK;
+	end &= PARAGRAPH_MASK;
+	if(end <= start + sizeof(memHeader_t) * 3 + MIN_BLOCK || heap_regions > MEM_REGIONS+1)
+		return tail;
+
+	/* leading fence footer, the block header follows on the next paragraph */
+	*(memHeader_t **) (start + PARAGRAPH_SIZE - sizeof(memHeader_t *)) = &mem_fence;
+
+	/* trailing fence header */
+	fence = (memHeader_t *) (end - sizeof(memHeader_t));
+	fence->size = 0;
+	fence->sanityCheck = (char*)FENCE_CHECK;
+
+	slot = (memHeader_t *) (start + PARAGRAPH_SIZE);
+	slot->size = (int)fence - (int)(&(slot->dataStart));
+	slot->sanityCheck = (char*)FREE_CHECK;
+	slot->prev = tail;
+	slot->next = NULL;
+	kmemtag(slot);
+
+	if(tail)
+		tail->next = slot;
+	else
+		memSlot = slot;
+
+	heap_map[heap_regions].start = start;
+	heap_map[heap_regions].end = end;
+	heap_regions++;
+
+	return slot;
+}
+
 /*
 * kmeminit
 *
 * @desc:	initialize the memory manager
+*
+* @note:	every usable memory region (see sizmem()) becomes a free block, clipped to the following bounds
+*		1. above freemem
+*		2. outside of the ramdisk image preloaded below RAMDISK_END
+*		3. outside of HOLESTART and HOLEEND
+*		4. below the page pool
+*
+*		the page pool is carved from the top of the highest region first and handed to the buddy allocator
 */
 void kmeminit(void)
 {
-	/*	
-	* set up two free blocks (data portion)
-	* 1. between freemem+hdr and HOLESTART
-	* 2. between HOLEEND-hdr and MAX_ADDR
-	*/
-	memSlot = (memHeader_t *) ((freemem + (int)PARAGRAPH_SIZE) & PARAGRAPH_MASK);
-	memSlot->size = HOLESTART - (int)(&(memSlot->dataStart));
-	memSlot->sanityCheck = (char*)SANITY_CHECK;
-	memSlot->prev = NULL;
-	memSlot->next = (memHeader_t *) HOLEEND;
+	int i, j;
+	unsigned int start, end, pool;
+	memHeader_t *tail = NULL;
+	mem_region_t rsv[2];
+
+	/* ranges kept out of the heap, in address order */
+	rsv[0].start = RAMDISK_END - *(unsigned short *) RAMDISK_K * 1024;
+	rsv[0].end = RAMDISK_END;
+	if(rsv[0].start < freemem)
+		rsv[0].start = rsv[0].end;	/* overwritten by the kernel, ram_init() drops it */
+	rsv[1].start = HOLESTART;
+	rsv[1].end = HOLEEND;
+
+	/* page pool takes at most half of the highest region */
+	end = mem_map[mem_regions-1].end;
+	pool = PAGE_POOL_SZ;
+	if(pool > (end - mem_map[mem_regions-1].start) / 2)
+		pool = ((end - mem_map[mem_regions-1].start) / 2) & PG_FRAME;
+	buddy_init(end - pool, end);
+
+	memSlot = NULL;
+	for(i=0 ; i<mem_regions ; i++)
+	{
+		start = mem_map[i].start;
+		end = mem_map[i].end;
+
+		if(start < freemem)
+			start = freemem;
+		if(end > page_pool_base)
+			end = page_pool_base;
+		if(end <= start)
+			continue;
+
+		/* the ramdisk image is used in place, the hole is kept for bootp loading and the monitor */
+		for(j=0 ; j<2 && start < end ; j++)
+		{
+			if(rsv[j].start == rsv[j].end || start >= rsv[j].end || end <= rsv[j].start)
+				continue;
+
+			if(start < rsv[j].start)
+				tail = kmemadd(start, rsv[j].start, tail);
+			start = rsv[j].end;
+		}
 
-	memSlot->next->size = (int)0x400000 - HOLEEND - (int)PARAGRAPH_SIZE;
-	memSlot->next->sanityCheck = (char*)SANITY_CHECK;
-	memSlot->next->prev = memSlot;
-	memSlot->next->next = NULL;
+		if(start < end)
+			tail = kmemadd(start, end, tail);
+	}
 
 #ifdef	MEM_DEBUG
 	kmemprint();
 #endif
 }
 
+/*
+* kmemvalid
+*
+* @desc:	check a range lies within a single heap region
+*
+* @param:	ptr		start of the range
+*		len		length of the range
+*
+* @output:	TRUE		range is heap memory
+*		FALSE		range is below freemem, in the hole, in the page pool or outside of usable memory
+*/
+Bool kmemvalid(void *ptr, int len)
+{
+	int i;
+	unsigned int start = (unsigned int) ptr, end = start + len;
+
+	if(len < 0 || end < start) return FALSE;
+
+	for(i=0 ; i<heap_regions ; i++)
+	{
+		if(start >= heap_map[i].start && end <= heap_map[i].end)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
 /*
 * kmalloc
 *
@@ -67,47 +299,71 @@ void kmeminit(void)
 * @param:	size		amount of memory space to allocate
 *
 * @output:	dataStart	start address of the data portion for an allocated memory block
+*
+* @note:	page-sized and larger requests are served by the buddy allocator, so they neither fragment 
+*		nor lengthen the first-fit list
 */
 void *kmalloc(int size)
 {
 	int amnt;			/* allocate memory amount */
 	memHeader_t *allocMemSlot;	/* holds the returned memory block */
 	memHeader_t *tmp;		
+	void *caller = __builtin_return_address(0);
 
 	if(size <= 0) return NULL;
 
-	/* calculate allocate bytes */
+	if(size >= NBPG)
+	{
+		amnt = page_order(size);
+		tmp = amnt == SYSERR ? NULL : page_alloc(amnt);
+		kmem_log(KMEM_ALLOC, tmp, tmp ? NBPG << amnt : 0, size, caller);
+		return tmp;
+	}
+
+	/* calculate allocate bytes, the footer tag is kept after the data */
+	size += sizeof(memHeader_t *);
 	amnt = (size / (int)PARAGRAPH_SIZE) + ((size % (int)PARAGRAPH_SIZE) ? 1 : 0);
 	amnt = amnt * (int)PARAGRAPH_SIZE + sizeof(memHeader_t);	/* Append hdr to amnt */
+	size -= sizeof(memHeader_t *);
 
 	/*
 	* find memory slot by cycling through the list of memory blocks until 
 	* the size+hdr of a memory block is bigger than the calculated amount
 	*/
-	for(allocMemSlot = memSlot; allocMemSlot && (((allocMemSlot->size) + sizeof(memHeader_t)) < amnt); allocMemSlot=allocMemSlot->next);
+	kmem.searches++;
+	for(allocMemSlot = memSlot; allocMemSlot && (((allocMemSlot->size) + sizeof(memHeader_t)) < amnt); allocMemSlot=allocMemSlot->next)
+		kmem.search_steps++;
+
 	if(!allocMemSlot)
+	{
+		kmem_log(KMEM_ALLOC, NULL, 0, size, caller);
 		return NULL;		/* no sufficient free space! */
+	}
 
-	/* reorder Memory Blocks */
-	tmp = (memHeader_t*) ((int)allocMemSlot + amnt);
-	tmp->size = allocMemSlot->size - amnt;
-	tmp->next = allocMemSlot->next;
-	tmp->prev = allocMemSlot->prev;
-
-	if(tmp->prev)
-		tmp->prev->next = tmp;			
-
-	if(tmp->next)
-		tmp->next->prev = tmp;			
+	/* split off the rest of the block when it can hold a block of its own, it takes over the list position */
+	if(allocMemSlot->size + sizeof(memHeader_t) - amnt >= MIN_BLOCK)
+	{
+		tmp = (memHeader_t*) ((int)allocMemSlot + amnt);
+		tmp->size = allocMemSlot->size - amnt;
+		tmp->sanityCheck = (char*)FREE_CHECK;
+		kmemtag(tmp);
+		kmemreplace(allocMemSlot, tmp);
 
-	if(!(tmp->prev)) 
-		memSlot = tmp;
+		allocMemSlot->size = amnt - sizeof(memHeader_t);
+	}
+	else
+	{
+		kmemunlink(allocMemSlot);
+		amnt = allocMemSlot->size + sizeof(memHeader_t);
+	}
 
 	/* set allocated memory block */
-	allocMemSlot->size = amnt - sizeof(memHeader_t);
 	allocMemSlot->sanityCheck = (char*)SANITY_CHECK;
 	allocMemSlot->next = NULL;
 	allocMemSlot->prev = NULL;
+	kmemtag(allocMemSlot);
+
+	kmem_log(KMEM_ALLOC, &(allocMemSlot->dataStart), amnt, size, caller);
 
 #ifdef	MEM_DEBUG
 	kmemprint();
@@ -122,98 +378,83 @@ void *kmalloc(int size)
 * @desc:	free allocated memory space and coalese to existing unallocated blocks if possible
 *
 * @param:	ptr		start of the allocated memory location
+*
+* @note:	the neighbours are found through the boundary tags, the header right after the block and the footer
+*		right before it, so a block is merged in constant time however fragmented the heap is. a block
+*		with no free neighbour is put at the head of the memory list
 */
 void kfree(void *ptr)
 {
-	if(ptr == NULL) return;
-	int memAddr = (int)((int*)ptr), diff; 
-	memHeader_t *allocSlot = NULL;
-	memHeader_t *tmpMemSlot = memSlot;
-	memHeader_t *tmp = NULL;
+	void *caller = __builtin_return_address(0);
+	int size;
+	memHeader_t *allocSlot, *next, *prev;
 
-	/*
-	* check for invalid 'dataStart' address,
-	* 1. smaller than the first memory block's 'dataStart',
-	* 2. in between HOLESTART and HOLEEND+hdr
-	* 3. bigger than (max_addr - 16)
-	*/
-	if(memAddr < ((freemem + ((int)PARAGRAPH_SIZE * 2)) & PARAGRAPH_MASK) ||
-	memAddr > (int) 0x400000 ||
-	(memAddr > HOLESTART && memAddr < (HOLEEND + sizeof(memHeader_t))))
-		return;
-	else
-		allocSlot = (memHeader_t *) (memAddr - sizeof(memHeader_t));
-
-	/* sanity check */
-	if(allocSlot->sanityCheck != (char*)SANITY_CHECK) return;
-
-	/*
-	* find closiest block to allocated memory block where the block is a non-header block,
-	* 'diff' is used as a comparison value between the following,
-	*
-	* 		FREE_MEMORY_BLOCK_END - ALLOCATED_MEMORY_BLOCK_START
-	*/
-	if(memAddr - sizeof(memHeader_t) >= (int)tmpMemSlot + sizeof(memHeader_t) + tmpMemSlot->size)
-		diff = memAddr - sizeof(memHeader_t) - (((int)tmpMemSlot + sizeof(memHeader_t) + tmpMemSlot->size));
+	if(ptr == NULL) return;
 
-	/* reattach allocated block into memory list */
-	while(tmpMemSlot) 
+	/* block from the buddy allocator */
+	if(is_page(ptr))
 	{
-		/* reattach allocated block at the start of memory list */
-		if(memAddr + allocSlot->size <= (int)tmpMemSlot && !(tmpMemSlot->prev))
+		size = page_size(ptr);
+		if(!size)
 		{
-			allocSlot->next = tmpMemSlot;
-			tmpMemSlot->prev = allocSlot;			
-			memSlot = allocSlot;
-			break;
+			kmem.bad_frees++;
+			return;
 		}
 
-		/*
-		* reattach allocated block at the body/tail of memory list
-		*
-		* the 'diff' value is updated until the smallest diff is found, 
-		* that is place where the allocated block will be placed back in
-		*/
-		if((int)tmpMemSlot + tmpMemSlot->size + (sizeof(memHeader_t)*2) <= memAddr &&
-		diff >= (memAddr - sizeof(memHeader_t) - ((int)tmpMemSlot + sizeof(memHeader_t) + tmpMemSlot->size)) &&
-		(memAddr - sizeof(memHeader_t) >= (int)tmpMemSlot + sizeof(memHeader_t) + tmpMemSlot->size))	
-		{
-			diff = memAddr - sizeof(memHeader_t) - (((int)tmpMemSlot + sizeof(memHeader_t) + tmpMemSlot->size));
-			allocSlot->prev = tmpMemSlot;
-		}
+		kmem_log(KMEM_FREE, ptr, size, size, caller);
+		page_free(ptr);
+		return;
+	}
 
-		tmpMemSlot = tmpMemSlot->next;			
+	/*
+	* check for invalid 'dataStart' address, the header must lie within a heap region
+	*/
+	allocSlot = (memHeader_t *) ((int)ptr - sizeof(memHeader_t));
+	if(!kmemvalid(allocSlot, sizeof(memHeader_t)))
+	{
+		kmem.bad_frees++;
+		return;
 	}
 
-	if(allocSlot->prev)
+	/* sanity check, this also catches a block that is freed twice */
+	if(allocSlot->sanityCheck != (char*)SANITY_CHECK)
 	{
-		allocSlot->next = allocSlot->prev->next;
-		allocSlot->prev->next = allocSlot;
+		kmem.bad_frees++;
+		return;
 	}
 
-	if(allocSlot->next)
-		allocSlot->next->prev = allocSlot;
+	size = allocSlot->size + sizeof(memHeader_t);
+	kmem_log(KMEM_FREE, ptr, size, size, caller);
 
-	/* coalese memory blocks */
-	tmpMemSlot = memSlot;
-	while(tmpMemSlot) 
+	/* coalese with the following block */
+	next = kmemnext(allocSlot);
+	if(next->sanityCheck == (char*)FREE_CHECK)
 	{
-		tmp = tmpMemSlot->next;
-		while(tmp)
-		{
-			/* check for base+hdr+size is equal to the next base */
-			if(((int)tmpMemSlot + sizeof(memHeader_t) + tmpMemSlot->size) == (int)tmp) 
-			{
-				tmpMemSlot->size = tmpMemSlot->size + tmp->size + sizeof(memHeader_t);
-				tmpMemSlot->next = tmp->next;
-			}
-	
-			tmp = tmp->next;		
-		}
+		kmemunlink(next);
+		allocSlot->size += next->size + sizeof(memHeader_t);
+		next->sanityCheck = NULL;
+	}
 
-		tmpMemSlot = tmpMemSlot->next;
+	/* coalese into the preceding block, which keeps its list position */
+	prev = kmemprev(allocSlot);
+	if(prev->sanityCheck == (char*)FREE_CHECK)
+	{
+		prev->size += allocSlot->size + sizeof(memHeader_t);
+		allocSlot->sanityCheck = NULL;
+		allocSlot = prev;
+	}
+	else
+	{
+		allocSlot->sanityCheck = (char*)FREE_CHECK;
+		allocSlot->prev = NULL;
+		allocSlot->next = memSlot;
+		if(memSlot)
+			memSlot->prev = allocSlot;
+		memSlot = allocSlot;
 	}
 
+	kmemtag(allocSlot);
+
 #ifdef	MEM_DEBUG
 	kmemprint();
 #endif
@@ -272,3 +513,125 @@ int kmemtotalsize (void)
 	}
 	return total_size;
 }
+
+/*
+* kmem_stats
+*
+* @desc:	fill in the allocator counters, and the free list histogram of the first-fit heap
+*
+* @param:	stats		buffer to fill in
+*
+* @output:	SYSOK		stats has been filled in
+*		SYSERR		null stats buffer
+*
+* @note:	the counters are kept on every kmalloc and kfree, only the free list is walked here
+*/
+int kmem_stats(kmem_stats_t *stats)
+{
+	int i;
+	memHeader_t *tmp;
+
+	if(!stats) return SYSERR;
+
+	for(i=0 ; i<KMEM_CLASSES ; i++)
+		kmem.free_blocks[i] = 0;
+	kmem.free_bytes = 0;
+	kmem.largest_free = 0;
+
+	for(tmp = memSlot ; tmp ; tmp = tmp->next)
+	{
+		kmem.free_blocks[kmem_class(tmp->size)]++;
+		kmem.free_bytes += tmp->size;
+		if(tmp->size > kmem.largest_free)
+			kmem.largest_free = tmp->size;
+	}
+
+	*stats = kmem;
+	return SYSOK;
+}
+
+/*
+* kmem_trace
+*
+* @desc:	start or stop recording every kmalloc and kfree with its caller, starting clears the old records
+*
+* @param:	on		TRUE to start tracing, FALSE to stop
+*/
+void kmem_trace(Bool on)
+{
+#if KMEM_TRACE_SZ
+	if(on && !kmem_tracing)
+		kmem_ring_i = 0;
+
+	kmem_tracing = on;
+#endif
+}
+
+/*
+* kmem_trace_read
+*
+* @desc:	copy the latest trace records, oldest first
+*
+* @param:	p		proc owning buf, NULL for a kernel buffer
+*		buf		buffer for the records
+*		n		number of records buf holds
+*
+* @output:	cnt		number of records copied
+*
+* @note:	a proc buffer must have passed validate_range()
+*/
+int kmem_trace_read(pcb_t *p, kmem_trace_t *buf, int n)
+{
+	int cnt = 0;
+#if KMEM_TRACE_SZ
+	unsigned int i = kmem_ring_i > KMEM_TRACE_SZ ? kmem_ring_i - KMEM_TRACE_SZ : 0;
+
+	/* only the latest n records fit in buf */
+	if(kmem_ring_i - i > n)
+		i = kmem_ring_i - n;
+
+	for( ; i<kmem_ring_i && cnt<n ; i++)
+		vm_copy(p, &buf[cnt++], NULL, &kmem_ring[i % KMEM_TRACE_SZ], sizeof(kmem_trace_t));
+#endif
+	return cnt;
+}
+
+/*
+* puts_kmem_stats
+*
+* @desc:	output the allocator counters and the free list histogram
+*/
+void puts_kmem_stats()
+{
+	int i;
+	kmem_stats_t s;
+
+	kmem_stats(&s);
+
+	kprintf("kmem: %d in use, %d peak, %d allocs, %d frees, %d failed, %d bad frees\n", 
+		s.in_use, s.peak, s.allocs, s.frees, s.failures, s.bad_frees);
+	kprintf("kmem: search length %d/%d, %d free bytes, largest %d\n",
+		s.search_steps, s.searches, s.free_bytes, s.largest_free);
+
+	kprintf("kmem classes: ");
+	for(i=0 ; i<KMEM_CLASSES ; i++)
+		kprintf("%d:%d/%d ", 16 << i, s.classes[i], s.free_blocks[i]);
+	kprintf("\n");
+}
+
+/*
+* puts_kmem_trace
+*
+* @desc:	output the latest trace records, oldest first
+*/
+void puts_kmem_trace()
+{
+#if KMEM_TRACE_SZ
+	int i, n;
+	kmem_trace_t t[KMEM_TRACE_SZ];
+
+	n = kmem_trace_read(NULL, t, KMEM_TRACE_SZ);
+	for(i=0 ; i<n ; i++)
+		kprintf("%s %d(%d) from %d\n", t[i].op == KMEM_ALLOC ? "alloc" : "free", t[i].ptr, t[i].size, t[i].caller);
+#endif
+}
@@ -24,7 +24,6 @@
 #include <xeroskernel.h>
 #include <i386.h>
 
-extern long freemem;		/* used to check buffer address location is in user stack space */
 
 /*
 * send
@@ -42,7 +41,6 @@ extern long freemem;		/* used to check buffer address location is in user stack
 void send(pcb_t *p, unsigned int pid, void *buffer, int buffer_len)
 {
 	ipc_t *comm = NULL, *dst_comm = NULL;
-	char *rcv_buffer, *snd_buffer;
 	int *mem = NULL;
 	pcb_t *proc = NULL;
 
@@ -64,15 +62,8 @@ void send(pcb_t *p, unsigned int pid, void *buffer, int buffer_len)
                 return;
 	}
 
-	/* check the buffer address is within the user stack space, 
-	* the buffer address should be ensured that it is not in the following regions.
-	* 1. below freemem
-	* 2. between holestart and holeend
-	* 3. above 4mb
-	*/
-	if( (int)buffer < freemem ||
-	( (int)buffer > HOLESTART && (int)buffer < HOLEEND ) ||
-	( (int)buffer > (int)0x400000 ))
+	/* check the buffer address is within the proc stack or user memory */
+	if(!validate_range(p, buffer, buffer_len))
 	{
          	p->state = READY_STATE; 
                 p->rc = ERR_IPC;
@@ -93,19 +84,17 @@ void send(pcb_t *p, unsigned int pid, void *buffer, int buffer_len)
         proc = unblock(&(p->blocked_receivers), pid);
         if(proc)
         {
-		/* transfer data from sender buffer to receiver buffer */
+		/* set return value as the number of bytes sent */
 		dst_comm = proc->ptr;
-		snd_buffer = (char *) comm->buffer;
-		rcv_buffer = (char *) dst_comm->buffer;
-		sprintf(rcv_buffer, "%s", snd_buffer);
-
-              	/* set return value as the number of bytes sent */
 		if(comm->buffer_len >= dst_comm->buffer_len)
 			p->rc = dst_comm->buffer_len;
 		else
 			p->rc = comm->buffer_len;
                 proc->rc = p->rc;
 
+		/* transfer data from sender buffer to receiver buffer, the receiver stack is in another address space */
+		vm_copy(proc, dst_comm->buffer, p, comm->buffer, p->rc);
+
                 /* set proc as ready and put back on ready_q */                 
                 p->state = READY_STATE;
                 proc->state = READY_STATE;      
@@ -119,14 +108,8 @@ void send(pcb_t *p, unsigned int pid, void *buffer, int buffer_len)
                 {
                 	/* check for receive any */
                         dst_comm = (ipc_t*) proc->ptr;
-                        if(proc->ptr && *(dst_comm->pid_ptr) == RECEIVE_ANY_PID && proc->state == BLOCK_ON_RECV_STATE)
+                        if(proc->ptr && dst_comm->pid == RECEIVE_ANY_PID && proc->state == BLOCK_ON_RECV_STATE)
                         {
-				/* transfer data from sender buffer to receiver buffer */
-				dst_comm = proc->ptr;
-				snd_buffer = (char *) comm->buffer;
-				rcv_buffer = (char *) dst_comm->buffer;
-				sprintf(rcv_buffer, "%s", snd_buffer);
-			
                         	/* set return value as the number of bytes sent */
 				if(comm->buffer_len >= dst_comm->buffer_len)
 					p->rc = dst_comm->buffer_len;
@@ -134,8 +117,12 @@ void send(pcb_t *p, unsigned int pid, void *buffer, int buffer_len)
 					p->rc = comm->buffer_len;
                                 proc->rc = p->rc;
 
+				/* transfer data from sender buffer to receiver buffer, the receiver stack is in another address space */
+				vm_copy(proc, dst_comm->buffer, p, comm->buffer, p->rc);
+
                                 /* update sender pid for the receiver */
-                                *(dst_comm->pid_ptr) = p->pid;
+                                dst_comm->pid = p->pid;
+                                copy_to_user(proc, dst_comm->pid_ptr, &(p->pid), sizeof(unsigned int));
 
                                 /* set proc as ready and put back on ready_q */                 
                                 p->state = READY_STATE;
@@ -158,6 +145,9 @@ void send(pcb_t *p, unsigned int pid, void *buffer, int buffer_len)
 				/* no deadlock detected, add proc to blocked_senders queue */
                         	block(&(proc->blocked_senders), p);
                                 p->state = BLOCK_ON_SEND_STATE;
+
+				/* a receiver polling for senders can now take the message */
+				poll_wake(proc);
   			}
 		}
                 else
@@ -188,12 +178,21 @@ void send(pcb_t *p, unsigned int pid, void *buffer, int buffer_len)
 void recv(pcb_t *p, unsigned int *pid, void *buffer, int buffer_len)
 {
 	ipc_t *comm = NULL, *src_comm = NULL;
-	char *rcv_buffer, *snd_buffer;
 	int *mem = NULL;
 	pcb_t *proc = NULL;
+	unsigned int from;
+
+	/* the sender pid is read from the receiver buffer, which must be memory the receiver may pass in */
+	if(copy_from_user(p, &from, pid, sizeof(unsigned int)) != sizeof(unsigned int))
+	{
+         	p->state = READY_STATE; 
+                p->rc = ERR_IPC;
+                ready(p);
+                return;
+	}
 
 	/* when an empty buffer_len or null buffer is passed, add current proc to ready_q */
-        if(p->pid == *pid)
+        if(p->pid == from)
         {
         	p->state = READY_STATE; 
                 p->rc = ERR_LOOPBACK;
@@ -211,15 +210,8 @@ void recv(pcb_t *p, unsigned int *pid, void *buffer, int buffer_len)
 		return;
 	}
 
-	/* check the buffer address is within the user stack space, 
-	* the buffer address should be ensured that it is not in the following regions.
-	* 1. below freemem
-	* 2. between holestart and holeend
-	* 3. above 4mb
-	*/
-	if( (int)buffer < freemem ||
-	( (int)buffer > HOLESTART && (int)buffer < HOLEEND ) ||
-	( (int)buffer > (int)0x400000 ))
+	/* check the buffer address is within the proc stack or user memory */
+	if(!validate_range(p, buffer, buffer_len))
 	{
          	p->state = READY_STATE; 
                 p->rc = ERR_IPC;
@@ -233,28 +225,31 @@ void recv(pcb_t *p, unsigned int *pid, void *buffer, int buffer_len)
         comm->pid_ptr = pid;
         comm->buffer = buffer;
         comm->buffer_len = buffer_len;
+        comm->pid = from;
         p->ptr = comm;
                                 
 
         /* search for ipc_receiver in block_q */
-        proc = unblock(&(p->blocked_senders), *pid);                
+        proc = unblock(&(p->blocked_senders), from);                
         if(proc)
         {
         	/* when the receiver wants to receive from pid 0, update to the actual sender pid */
-                if(!(*pid)) *pid = proc->pid;
-
-		/* transfer data from sender buffer to receiver buffer */
-		src_comm = proc->ptr;
-		snd_buffer = (char *) src_comm->buffer;
-		rcv_buffer = (char *) comm->buffer;
-		sprintf(rcv_buffer, "%s", snd_buffer);
+                if(!from)
+		{
+			from = comm->pid = proc->pid;
+			copy_to_user(p, pid, &from, sizeof(unsigned int));
+		}
 
                 /* set return value as the number of bytes sent */
+		src_comm = proc->ptr;
 		if(comm->buffer_len >= src_comm->buffer_len)
 			p->rc = src_comm->buffer_len;
 		else
 			p->rc = comm->buffer_len;
                 proc->rc = p->rc;                                    
+
+		/* transfer data from sender buffer to receiver buffer, the sender stack is in another address space */
+		vm_copy(p, comm->buffer, proc, src_comm->buffer, p->rc);
                               
                 /* set proc as ready and put back on ready_q */         
                 p->state = READY_STATE;
@@ -265,14 +260,14 @@ void recv(pcb_t *p, unsigned int *pid, void *buffer, int buffer_len)
         else
         {
         	/* place receive_any receiver in block state, this process now is no longer attached to any queues */
-                if(!(*pid))
+                if(!from)
                 {
                 	p->state = BLOCK_ON_RECV_STATE;
 			return;
 		}
 
                 /* sender not found, snd_proc is now blocked */
-                proc = get_proc(*pid);
+                proc = get_proc(from);
                 if(proc) 
                 {
                 	/* deadlock detection for ipc blocked send/receive queues */
@@ -444,7 +439,7 @@ void puts_blocked_q()
                         while(tmp)
                         {
 				comm = (ipc_t *) tmp->ptr;
-                                kprintf("%d(%d) ", tmp->pid, *(comm->pid_ptr));
+                                kprintf("%d(%d) ", tmp->pid, comm->pid);
                                 tmp=tmp->next;
                         }
                         kprintf("\n");
@@ -474,7 +469,7 @@ void puts_receive_any ()
                 comm = (ipc_t *) proc_table[i].ptr;
                 
                 /* cycle through the process table and look for proc whose dest_proc pid is 0 and whose state is BLOCK_ON_RECV_STATE */
-                if(*(comm->pid_ptr) == RECEIVE_ANY_PID && proc_table[i].state == BLOCK_ON_RECV_STATE)
+                if(comm->pid == RECEIVE_ANY_PID && proc_table[i].state == BLOCK_ON_RECV_STATE)
                         kprintf("%d ", proc_table[i].pid);
         }
         kprintf("\n");
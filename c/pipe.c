@@ -0,0 +1,522 @@
+/* Pipe Device Driver
+ *
+ * This is the pipe device driver, a pipe is a kernel ring of bytes with a
+ * read end and a write end, each opened through fds of their own. Bytes are
+ * copied straight between the ring and proc buffers, and blocked writers are
+ * refilled in batches once readers have drained the ring to a low watermark.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <pipe.h>
+
+typedef struct pipei pipei_t;		/* queued read or blocked write, one per proc waiting on a pipe */
+struct pipei
+{
+	pcb_t* p;
+	fd_t* f;
+	void* buf;
+	int buflen;
+	int bufi;
+	pipei_t* next;
+};
+
+typedef struct pipe pipe_t;		/* bytes indexed by free running counters modulo PIPE_RING_SZ */
+struct pipe
+{
+	unsigned char *buf;		/* ring, NULL for a free slot 				*/
+	unsigned int head;		/* bytes written 					*/
+	unsigned int tail;		/* bytes read 						*/
+	int refs[2];			/* fds holding the read end and the write end 		*/
+	pipei_t *rq;			/* queued reads, only while the ring is empty 		*/
+	pipei_t *wq;			/* blocked writes, in the order they were made 		*/
+};
+
+static pipe_t pipe_table[PIPE_SZ];
+
+#define pipe_cnt(pi)	((pi)->head - (pi)->tail)
+#define pipe_of(f)	(&pipe_table[(f)->dvminor >> 1])
+#define pipe_end(f)	((f)->dvminor & 1)
+
+
+/*
+* pipe_in
+*
+* @desc:	copy a proc buffer into the ring of a pipe, through the proc's address space
+*
+* @output:	n		number of bytes copied, limited by the free space of the ring
+*/
+static int pipe_in(pipe_t *pi, pcb_t *p, unsigned char *buf, int len)
+{
+	unsigned int n, start;
+	int cnt = 0;
+
+	while(cnt < len && pipe_cnt(pi) < PIPE_RING_SZ)
+	{
+		start = pi->head & PIPE_RING_MASK;
+		n = PIPE_RING_SZ - pipe_cnt(pi);
+		if(n > PIPE_RING_SZ - start)
+			n = PIPE_RING_SZ - start;
+		if(n > len - cnt)
+			n = len - cnt;
+
+		vm_copy(NULL, &pi->buf[start], p, buf + cnt, n);
+		pi->head += n;
+		cnt += n;
+	}
+
+	return cnt;
+}
+
+/*
+* pipe_out
+*
+* @desc:	copy the bytes held in the ring of a pipe into a proc buffer, through the proc's address space
+*
+* @output:	n		number of bytes copied, limited by the bytes held in the ring
+*/
+static int pipe_out(pipe_t *pi, pcb_t *p, unsigned char *buf, int len)
+{
+	unsigned int n, start;
+	int cnt = 0;
+
+	while(cnt < len && pipe_cnt(pi))
+	{
+		start = pi->tail & PIPE_RING_MASK;
+		n = pipe_cnt(pi);
+		if(n > PIPE_RING_SZ - start)
+			n = PIPE_RING_SZ - start;
+		if(n > len - cnt)
+			n = len - cnt;
+
+		vm_copy(p, buf + cnt, NULL, &pi->buf[start], n);
+		pi->tail += n;
+		cnt += n;
+	}
+
+	return cnt;
+}
+
+/*
+* pipe_enqueue
+*
+* @desc:	place a read or write at the tail of a pipe queue
+*
+* @output:	k		queued request, NULL when no kernel memory is left
+*/
+static pipei_t *pipe_enqueue(pipei_t **q, pcb_t *p, fd_t *f, void *buf, int buflen, int bufi)
+{
+	pipei_t *k = (pipei_t *) kmalloc(sizeof(pipei_t));
+
+	if(!k)
+		return NULL;
+
+	k->p = p;
+	k->f = f;
+	k->buf = buf;
+	k->buflen = buflen;
+	k->bufi = bufi;
+	k->next = NULL;
+
+	for( ; *q ; q = &((*q)->next));
+	*q = k;
+
+	return k;
+}
+
+/*
+* pipe_wdone
+*
+* @desc:	ready a blocked writer with rc and release its queue entry
+*/
+static void pipe_wdone(pipei_t *k, int rc)
+{
+	k->p->rc = rc;
+	k->p->state = READY_STATE;
+	ready(k->p);
+	kfree(k);
+}
+
+/*
+* pipe_pump
+*
+* @desc:	move bytes from blocked writers into the ring and out of the ring to queued readers, for as long as
+*		either side makes progress
+*
+* @param:	pi		pipe
+*		moved		bytes were already moved by the caller, procs polling pipes are rechecked
+*
+* @note:	a blocked writer is refilled once the ring has drained to PIPE_LOWAT, or once the rest of its write
+*		fits, so it is readied after a few large copies rather than after every read. a queued reader is
+*		completed with whatever the ring holds, or with 0 once no fd holds the write end
+*/
+static void pipe_pump(pipe_t *pi, int moved)
+{
+	pipei_t *k;
+	int n;
+
+	do
+	{
+		n = 0;
+
+		while((k = pi->wq) && (pipe_cnt(pi) <= PIPE_LOWAT || k->buflen - k->bufi <= PIPE_RING_SZ - pipe_cnt(pi)))
+		{
+			k->bufi += pipe_in(pi, k->p, (unsigned char *) k->buf + k->bufi, k->buflen - k->bufi);
+			n = 1;
+
+			if(k->bufi < k->buflen)
+				break;
+
+			pi->wq = k->next;
+			pipe_wdone(k, k->bufi);
+		}
+
+		while((k = pi->rq) && (pipe_cnt(pi) || !pi->refs[PIPE_WR]))
+		{
+			pi->rq = k->next;
+			di_complete(k->p, k->f, pipe_out(pi, k->p, k->buf, k->buflen));
+			kfree(k);
+			n = 1;
+		}
+
+		moved |= n;
+	}
+	while(n);
+
+	if(moved)
+		di_wake(&(dev_table[PIPE]));
+}
+
+/*
+* pipe_unqueue
+*
+* @desc:	take the requests of proc off a pipe queue
+*
+* @param:	q		pipe queue
+*		p		proc whose requests are taken off
+*		f		fd whose requests are taken off, NULL for the request proc is blocked on
+*		reads		q holds reads, a queued O_ASYNC read does not block its proc so f NULL leaves it
+*
+* @output:	cnt		number of requests taken off
+*/
+static int pipe_unqueue(pipei_t **q, pcb_t *p, fd_t *f, Bool reads)
+{
+	pipei_t *k;
+	int cnt = 0;
+
+	while((k = *q))
+	{
+		if(k->p != p || (f ? k->f != f : reads && k->f->flags & O_ASYNC))
+		{
+			q = &(k->next);
+			continue;
+		}
+
+		*q = k->next;
+		kfree(k);
+		cnt++;
+	}
+
+	return cnt;
+}
+
+/*
+* pipe_init
+*
+* @desc:	register the pipe device
+*/
+void pipe_init()
+{
+	devsw_t d;
+
+	memset(pipe_table, 0, sizeof(pipe_table));
+
+	memset(&d, 0, sizeof(devsw_t));
+	d.dvnum    	= PIPE;
+	d.dvopen   	= pipe_open;
+	d.dvread   	= pipe_read;
+	d.dvwrite  	= pipe_write;
+	d.dvcancel   	= pipe_cancel;
+	d.dvpoll   	= pipe_poll;
+	d.dvref   	= pipe_ref;
+	di_register(&d);
+}
+
+/*
+* pipe_create
+*
+* @desc:	allocate a pipe with an empty ring
+*
+* @output:	minor		minor number of the read end, the write end is minor | PIPE_WR, SYSERR when every
+*				pipe is in use or no kernel memory is left
+*
+* @note:	the pipe is released once no fd holds either end, the ends are taken by di_pipe() through pipe_ref()
+*/
+int pipe_create()
+{
+	int i;
+
+	for(i=0 ; i<PIPE_SZ && pipe_table[i].buf ; i++);
+	if(i == PIPE_SZ)
+		return SYSERR;
+
+	pipe_table[i].buf = (unsigned char *) kmalloc(PIPE_RING_SZ);
+	if(!pipe_table[i].buf)
+		return SYSERR;
+
+	pipe_table[i].head = 0;
+	pipe_table[i].tail = 0;
+	pipe_table[i].refs[PIPE_RD] = 0;
+	pipe_table[i].refs[PIPE_WR] = 0;
+	pipe_table[i].rq = NULL;
+	pipe_table[i].wq = NULL;
+
+	return (i << 1) | PIPE_RD;
+}
+
+/*
+* pipe_open
+*
+* @desc:	called by sysopen() while no pipe end is open at all, there is no pipe to open
+*
+* @output:	rc		returns -1, pipes are created by syspipe()
+*
+* @note:	once a pipe exists, either of its ends may also be opened by its device number, see pipe_ref()
+*/
+int pipe_open(devsw_t* d, fd_t *f)
+{
+	return DEV_ERR;
+}
+
+/*
+* pipe_ref
+*
+* @desc:	count an fd taking or dropping an end of a pipe
+*
+* @param:	d
+*		f		fd holding the end
+*		delta		1 when the fd is opened or inherited by fork, -1 when it is closed
+*
+* @output:	rc		returns 0 on success, -1 when the minor of f names no pipe
+*
+* @note:	once no fd holds the write end, queued reads complete with 0. once no fd holds the read end, blocked
+*		writers are readied with -1 and the bytes left in the ring are dropped. the pipe is released with
+*		the last fd on either end
+*/
+int pipe_ref(devsw_t* d, fd_t *f, int delta)
+{
+	pipe_t *pi;
+	pipei_t *k;
+
+	if((f->dvminor >> 1) >= PIPE_SZ || !pipe_of(f)->buf)
+		return DEV_ERR;
+
+	pi = pipe_of(f);
+
+	pi->refs[pipe_end(f)] += delta;
+	if(pi->refs[pipe_end(f)])
+		return DEV_SUCCESS;
+
+	if(pipe_end(f) == PIPE_RD)
+	{
+		while((k = pi->wq))
+		{
+			pi->wq = k->next;
+			pipe_wdone(k, DEV_ERR);
+		}
+		pi->tail = pi->head;
+	}
+
+	if(!pi->refs[PIPE_RD] && !pi->refs[PIPE_WR])
+	{
+		kfree(pi->buf);
+		pi->buf = NULL;
+		return DEV_SUCCESS;
+	}
+
+	pipe_pump(pi, TRUE);
+	return DEV_SUCCESS;
+}
+
+/*
+* pipe_write
+*
+* @desc:	copies a user buffer into a pipe, blocking the proc until all of it has been taken by the ring
+*
+* @param:	p		proc writing to the pipe
+*		d
+*		f		fd holding the write end
+*		buf		user buffer
+*		buflen		user buffer length
+*
+* @output:	rc		number of bytes copied, -1 when f holds the read end, buf is not memory the proc may
+*				pass in or no fd holds the read end, BLOCKERR when f is O_NONBLOCK and the ring is full
+*
+* @note:	this is an upper layer function, writes blocked ahead of this one are queued first so writes are
+*		never interleaved. an O_NONBLOCK write copies what fits and never blocks
+*/
+int pipe_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen)
+{
+	pipe_t *pi = pipe_of(f);
+	int n = 0;
+
+	if(pipe_end(f) != PIPE_WR || !validate_range(p, buf, buflen) || !pi->refs[PIPE_RD])
+		return DEV_ERR;
+
+	if(!pi->wq)
+		n = pipe_in(pi, p, buf, buflen);
+
+	if(n < buflen && !(f->flags & O_NONBLOCK))
+	{
+		/* the pump may complete the write right away, which readies the proc */
+		if(pipe_enqueue(&(pi->wq), p, f, buf, buflen, n))
+			p->state = BLOCK_ON_DEV_STATE;
+		else if(!n)
+			n = DEV_ERR;
+	}
+
+	pipe_pump(pi, n > 0);
+
+	if(f->flags & O_NONBLOCK)
+		return n || !buflen ? n : BLOCKERR;
+
+	return n;
+}
+
+/*
+* pipe_read
+*
+* @desc:	takes the bytes held in a pipe, blocking the proc until at least one byte has been written
+*
+* @param:	p		proc reading from the pipe
+*		d
+*		f		fd holding the read end
+*		buf		user buffer
+*		buflen		user buffer length
+*
+* @output:	rc		returns 0 on success, -1 when f holds the write end or buf is not memory the proc may
+*				pass in, BLOCKERR when f is O_NONBLOCK and the ring is empty
+*
+* @note:	this is an upper layer function, the read is completed before returning when the ring holds bytes,
+*		or with 0 once no fd holds the write end
+*/
+int pipe_read(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen)
+{
+	pipe_t *pi = pipe_of(f);
+	int n;
+
+	if(pipe_end(f) != PIPE_RD || !validate_range(p, buf, buflen))
+		return DEV_ERR;
+
+	if(pipe_cnt(pi) || !pi->refs[PIPE_WR])
+	{
+		n = pipe_out(pi, p, buf, buflen);
+		di_complete(p, f, n);
+
+		/* the room freed may let blocked writers go on */
+		pipe_pump(pi, n > 0);
+		return DEV_SUCCESS;
+	}
+
+	if(f->flags & O_NONBLOCK)
+		return BLOCKERR;
+
+	if(!pipe_enqueue(&(pi->rq), p, f, buf, buflen, 0))
+		return DEV_ERR;
+
+	return DEV_SUCCESS;
+}
+
+/*
+* pipe_cancel
+*
+* @desc:	withdraws the queued reads and blocked writes of proc
+*
+* @param:	d
+*		p		proc whose requests are withdrawn
+*		f		fd whose requests are withdrawn, NULL for the one proc is blocked on, which readies proc
+*
+* @note:	this is an upper layer function, bytes of an abandoned write that were already copied stay in the ring
+*/
+int pipe_cancel(devsw_t* d, pcb_t *p, fd_t *f)
+{
+	int i, cnt = 0;
+
+	for(i=0 ; i<PIPE_SZ ; i++)
+	{
+		if(!pipe_table[i].buf || (f && pipe_of(f) != &pipe_table[i]))
+			continue;
+
+		cnt += pipe_unqueue(&(pipe_table[i].rq), p, f, TRUE);
+		cnt += pipe_unqueue(&(pipe_table[i].wq), p, f, FALSE);
+
+		/* writers queued behind an abandoned write may go on */
+		pipe_pump(&pipe_table[i], FALSE);
+	}
+
+	if(!cnt)
+		return DEV_ERR;
+
+	if(!f)
+	{
+		p->state = READY_STATE;
+		ready(p);
+	}
+	return DEV_SUCCESS;
+}
+
+/*
+* pipe_poll
+*
+* @desc:	the read end is ready once the ring holds bytes or no fd holds the write end, the write end is ready
+*		once no write is blocked and the ring has drained to PIPE_HIWAT
+*
+* @output:	revents		POLLIN, POLLOUT, or POLLERR for a write end whose read end is no longer held
+*/
+int pipe_poll(devsw_t* d, fd_t *f, unsigned int events)
+{
+	pipe_t *pi = pipe_of(f);
+
+	if(pipe_end(f) == PIPE_RD)
+		return pipe_cnt(pi) || !pi->refs[PIPE_WR] ? POLLIN : 0;
+
+	if(!pi->refs[PIPE_RD])
+		return POLLERR;
+
+	return !pi->wq && pipe_cnt(pi) <= PIPE_HIWAT ? POLLOUT : 0;
+}
+
+/*
+* puts_pipe
+*
+* @desc:	outputs the bytes held and the fds on each end of every pipe
+*/
+void puts_pipe()
+{
+	int i;
+
+	kprintf("pipe: ");
+	for(i=0 ; i<PIPE_SZ ; i++)
+	{
+		if(pipe_table[i].buf)
+			kprintf("%d(%d bytes, %d rd, %d wr) ", i, pipe_cnt(&pipe_table[i]), pipe_table[i].refs[PIPE_RD], pipe_table[i].refs[PIPE_WR]);
+	}
+	kprintf("\n");
+}
@@ -0,0 +1,248 @@
+/* Poll
+ *
+ * This is the poll unit, a proc waits in syspoll() for any entry of a set
+ * of fds, blocked senders and pending signals to become ready, or for a
+ * timeout. The set is checked once when the proc blocks; after that each
+ * subsystem rechecks only the procs waiting on it when its state changes,
+ * devices through their wait queue, ipc and signals through the target proc.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+
+extern devsw_t dev_table[DEV_SZ];
+
+typedef struct pollctx pollctx_t;	/* poll in progress, held in the generic ptr in pcb */
+struct pollctx
+{
+	pollfd_t *uset;			/* user set, revents are copied back on completion 	*/
+	int n;
+	Bool sleeping;			/* proc is on the sleep_q for the timeout 		*/
+	pollfd_t set[POLL_SZ];
+	wait_t wait[POLL_SZ];		/* wait queue entries of the POLL_FD entries 		*/
+	devsw_t *dev[POLL_SZ];		/* device each wait queue entry is linked to, or NULL 	*/
+};
+
+
+/*
+* poll_scan
+*
+* @desc:	set the revents of every entry of a poll
+*
+* @output:	cnt		number of entries with revents set
+*/
+static int poll_scan(pcb_t *p, pollctx_t *c)
+{
+	pcb_t *tmp;
+	pollfd_t *e;
+	int i, cnt = 0;
+
+	for(i=0 ; i<c->n ; i++)
+	{
+		e = &(c->set[i]);
+		e->revents = 0;
+
+		switch(e->kind)
+		{
+			case POLL_FD:
+				e->revents = di_poll(p, e->id, e->events);
+				break;
+
+			case POLL_MSG:
+				for(tmp = p->blocked_senders ; tmp ; tmp = tmp->next)
+				{
+					if(!e->id || tmp->pid == e->id)
+					{
+						e->revents = POLLIN;
+						break;
+					}
+				}
+				break;
+
+			case POLL_SIG:
+				if(p->sig_pend_mask & e->id)
+					e->revents = POLLIN;
+				break;
+
+			default:
+				e->revents = POLLERR;
+				break;
+		}
+
+		if(e->revents)
+			cnt++;
+	}
+
+	return cnt;
+}
+
+/*
+* poll_done
+*
+* @desc:	complete a poll, the revents are copied back to the user set and the proc is readied with rc
+*/
+static void poll_done(pcb_t *p, int rc)
+{
+	pollctx_t *c = (pollctx_t *) p->ptr;
+	wait_t **q;
+	int i;
+
+	/* unlink from the device wait queues */
+	for(i=0 ; i<c->n ; i++)
+	{
+		if(!c->dev[i])
+			continue;
+
+		for(q = &(c->dev[i]->dvwait) ; *q && *q != &(c->wait[i]) ; q = &((*q)->next));
+		if(*q)
+			*q = c->wait[i].next;
+	}
+
+	if(c->sleeping)
+		unsleep(p);
+
+	for(i=0 ; i<c->n ; i++)
+		copy_to_user(p, &(c->uset[i].revents), &(c->set[i].revents), sizeof(unsigned int));
+
+	kfree(c);
+	p->ptr = NULL;
+
+	p->rc = rc;
+	p->state = READY_STATE;
+	ready(p);
+}
+
+/*
+* poll
+*
+* @desc:	wait for any entry of a set to be ready
+*
+* @param:	p		proc polling
+*		set		user set of entries
+*		n		number of entries, at most POLL_SZ
+*		timeout_ms	time to wait in milliseconds, 0 to only check the set, negative to wait without a timeout
+*
+* @note:	the proc is readied with the number of ready entries, 0 on timeout, or SYSERR for an invalid set
+*/
+void poll(pcb_t *p, pollfd_t *set, int n, int timeout_ms)
+{
+	pollctx_t *c;
+	fd_t *f;
+	int i, cnt;
+
+	p->rc = SYSERR;
+	p->state = READY_STATE;
+
+	if(n <= 0 || n > POLL_SZ || !validate_range(p, set, n * sizeof(pollfd_t)))
+	{
+		ready(p);
+		return;
+	}
+
+	c = (pollctx_t *) kmalloc(sizeof(pollctx_t));
+	if(!c)
+	{
+		ready(p);
+		return;
+	}
+
+	copy_from_user(p, c->set, set, n * sizeof(pollfd_t));
+	c->uset = set;
+	c->n = n;
+	c->sleeping = FALSE;
+	for(i=0 ; i<n ; i++)
+		c->dev[i] = NULL;
+	p->ptr = c;
+
+	cnt = poll_scan(p, c);
+	if(cnt || !timeout_ms)
+	{
+		poll_done(p, cnt);
+		return;
+	}
+
+	/* wait on the devices of the fd entries */
+	for(i=0 ; i<n ; i++)
+	{
+		if(c->set[i].kind != POLL_FD)
+			continue;
+
+		f = &(p->fd_table[c->set[i].id]);
+		c->dev[i] = &(dev_table[f->dvmajor]);
+		c->wait[i].p = p;
+		c->wait[i].next = c->dev[i]->dvwait;
+		c->dev[i]->dvwait = &(c->wait[i]);
+	}
+
+	p->state = BLOCK_ON_POLL_STATE;
+
+	if(timeout_ms > 0)
+	{
+		p->delta_slice = sleep_to_slice(timeout_ms);
+		sleep(p);
+		c->sleeping = TRUE;
+	}
+}
+
+/*
+* poll_wake
+*
+* @desc:	recheck the set of a polling proc after an event it may be waiting for
+*
+* @output:	TRUE		poll has completed and the proc has been readied
+*/
+Bool poll_wake(pcb_t *p)
+{
+	int cnt;
+
+	if(p->state != BLOCK_ON_POLL_STATE)
+		return FALSE;
+
+	cnt = poll_scan(p, (pollctx_t *) p->ptr);
+	if(!cnt)
+		return FALSE;
+
+	poll_done(p, cnt);
+	return TRUE;
+}
+
+/*
+* poll_timeout
+*
+* @desc:	complete a poll whose timeout is up, called when the proc leaves the sleep_q
+*/
+void poll_timeout(pcb_t *p)
+{
+	((pollctx_t *) p->ptr)->sleeping = FALSE;
+	poll_done(p, 0);
+}
+
+/*
+* poll_signal
+*
+* @desc:	complete a poll after a signal has been pended for the proc
+*
+* @note:	the poll reports a POLL_SIG entry that matches the signal, otherwise it is interrupted like any other
+*		blocking call
+*/
+void poll_signal(pcb_t *p)
+{
+	if(!poll_wake(p))
+		poll_done(p, ERR_SIGNAL_UNBLOCK_SYSCALL);
+}
@@ -0,0 +1,231 @@
+/* RAM Disk Device Driver
+ *
+ * This is the ram disk block device, its blocks live in memory and every
+ * read and write goes through the buffer cache. The disk holds the image
+ * boot/build.c appended to the boot image, which setup leaves in low memory
+ * below RAMDISK_END, or an empty disk of RAMDISK_SZ from the heap.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+#include <ramdisk.h>
+
+extern long freemem;
+
+static unsigned char *ram_base = NULL;	/* disk bytes 				*/
+static blkdev_t ram_blk;
+
+
+/*
+* ram_bread
+*
+* @desc:	copy a disk block into a cache buffer
+*/
+static int ram_bread(blkdev_t *b, unsigned int blk, void *buf)
+{
+	blkcopy(ram_base + blk * BLK_SZ, buf, BLK_SZ);
+	return SYSOK;
+}
+
+/*
+* ram_bwrite
+*
+* @desc:	copy a cache buffer into a disk block
+*/
+static int ram_bwrite(blkdev_t *b, unsigned int blk, void *buf)
+{
+	blkcopy(buf, ram_base + blk * BLK_SZ, BLK_SZ);
+	return SYSOK;
+}
+
+/*
+* ram_init
+*
+* @desc:	take the preloaded image, or allocate an empty disk, and register the ram disk device
+*
+* @note:	the image is used where setup left it, kmeminit() keeps it out of the heap. an image that reaches
+*		below freemem has been overwritten by the kernel and is dropped for an empty disk
+*/
+void ram_init()
+{
+	devsw_t d;
+	unsigned int size = *(unsigned short *) RAMDISK_K * 1024;
+
+	if(size && RAMDISK_END - size >= freemem)
+		ram_base = (unsigned char *) (RAMDISK_END - size);
+	else
+	{
+		if(size)
+			klog(KLOG_WARN, "ramdisk: image of %d KB overlaps the kernel, dropped\n", size / 1024);
+
+		size = RAMDISK_SZ;
+		ram_base = (unsigned char *) kmalloc(size);
+		if(!ram_base)
+			return;
+		memset(ram_base, 0, size);
+	}
+
+	ram_blk.nblks = size / BLK_SZ;
+	ram_blk.bread = ram_bread;
+	ram_blk.bwrite = ram_bwrite;
+
+	memset(&d, 0, sizeof(devsw_t));
+	d.dvnum    	= RAMDISK;
+	d.dvopen   	= ram_open;
+	d.dvclose  	= ram_close;
+	d.dvread   	= ram_read;
+	d.dvwrite  	= ram_write;
+	d.dvcntl   	= ram_ioctl;
+	d.dvpoll   	= ram_poll;
+	d.dvioblk  	= &ram_blk;
+	di_register(&d);
+}
+
+/*
+* ram_open
+*
+* @desc:	the disk needs no setup, opening always succeeds
+*
+* @output:	rc		returns 0 on successful device open
+*/
+int ram_open(devsw_t* d, fd_t *f)
+{
+	return DEV_SUCCESS;
+}
+
+/*
+* ram_close
+*
+* @desc:	writes back the dirty cached blocks of the disk on the last close
+*
+* @output:	rc		returns 0 on successful device close
+*/
+int ram_close(devsw_t* d, fd_t *f)
+{
+	return bcache_sync(&ram_blk) == SYSOK ? DEV_SUCCESS : DEV_ERR;
+}
+
+/*
+* ram_write
+*
+* @desc:	copies a user buffer to the disk at the fd offset, and advances the offset
+*
+* @param:	p		proc writing to the device
+*		d
+*		f
+*		buf		user buffer
+*		buflen		user buffer length
+*
+* @output:	rc		number of bytes written, short at the end of the disk, -1 when buf is not memory the
+*				proc may pass in
+*
+* @note:	this is an upper layer function, the blocks are only marked dirty in the buffer cache
+*/
+int ram_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen)
+{
+	int n;
+
+	if(!validate_range(p, buf, buflen))
+		return DEV_ERR;
+
+	n = bcache_write(&ram_blk, f->offset, p, buf, buflen);
+	if(n < 0)
+		return DEV_ERR;
+
+	f->offset += n;
+	return n;
+}
+
+/*
+* ram_read
+*
+* @desc:	copies disk bytes at the fd offset into a user buffer, and advances the offset
+*
+* @param:	p		proc reading from the device
+*		d
+*		f
+*		buf		user buffer
+*		buflen		user buffer length
+*
+* @output:	rc		returns 0 on success, -1 when buf is not memory the proc may pass in
+*
+* @note:	this is an upper layer function, the read always completes before returning, with 0 at the end of
+*		the disk
+*/
+int ram_read(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen)
+{
+	int n;
+
+	if(!validate_range(p, buf, buflen))
+		return DEV_ERR;
+
+	n = bcache_read(&ram_blk, f->offset, p, buf, buflen);
+	if(n < 0)
+		return DEV_ERR;
+
+	f->offset += n;
+	di_complete(p, f, n);
+	return DEV_SUCCESS;
+}
+
+/*
+* ram_ioctl
+*
+* @desc:	block device commands
+*
+* @param:	command		BLK_SEEK	set the fd offset to arg bytes, at most the disk size
+*				BLK_SIZE	get the disk size in bytes
+*				BLK_SYNC	write back the dirty cached blocks of the disk
+*		arg		command argument
+*
+* @output:	rc		returns 0 or the disk size on success, -1 for any other command or an offset past the disk
+*/
+int ram_ioctl(devsw_t* d, fd_t *f, unsigned long command, int arg)
+{
+	switch(command)
+	{
+		case BLK_SEEK:
+			if(arg < 0 || arg > ram_blk.nblks * BLK_SZ)
+				return DEV_ERR;
+			f->offset = arg;
+			return DEV_SUCCESS;
+
+		case BLK_SIZE:
+			return ram_blk.nblks * BLK_SZ;
+
+		case BLK_SYNC:
+			return bcache_sync(&ram_blk) == SYSOK ? DEV_SUCCESS : DEV_ERR;
+	}
+
+	return DEV_ERR;
+}
+
+/*
+* ram_poll
+*
+* @desc:	reads and writes of the disk never block
+*
+* @output:	revents		POLLIN and POLLOUT
+*/
+int ram_poll(devsw_t* d, fd_t *f, unsigned int events)
+{
+	return POLLIN | POLLOUT;
+}
@@ -0,0 +1,289 @@
+/* Real-time Scheduler
+ *
+ * This is the earliest deadline first scheduling class used for periodic
+ * processes registered through sysrtset().
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+
+extern pcb_t proc_table[PROC_SZ];
+
+pcb_t *rt_q;				/* released jobs, ordered by absolute deadline 		*/
+pcb_t *rt_wait_q;			/* completed or throttled jobs, ordered by next release */
+static unsigned int rt_ticks = 0;	/* real-time clock in timer ticks 			*/
+
+/* proc has been admitted into the real-time class and has not stopped */
+#define rt_member(p)	((p)->pid != INVALID_PID && (p)->state != STOP_STATE && (p)->sched_class == SCHED_CLASS_RT)
+
+/*
+* rt_set
+*
+* @desc:	admit proc into the real-time class with the provided period, budget and deadline
+*
+* @param:	p		proc to be admitted
+*		period_ms	period in milliseconds, 0 returns the proc to the time sharing class
+*		budget_ms	execution budget per period in milliseconds
+*		deadline_ms	deadline relative to each release in milliseconds, 0 uses the period
+*
+* @output:	SYSOK		proc has been admitted, its first job is released immediately
+*		ERR_RT_PARAM	budget is 0, or budget > deadline > period
+*		ERR_RT_ADMIT	sum of budget/deadline over all real-time proc would exceed RT_UTIL_MAX
+*
+* @note:	admission uses the density test (sum of budget/deadline <= 1), which is sufficient for
+*		edf to meet every deadline when deadlines are no longer than periods
+*/
+int rt_set(pcb_t *p, unsigned int period_ms, unsigned int budget_ms, unsigned int deadline_ms)
+{
+	int i;
+	unsigned int period, budget, deadline, util=0;
+
+	/* leave the real-time class */
+	if(!period_ms)
+	{
+		p->sched_class = SCHED_CLASS_TS;
+		p->slice = quantum(p);
+		return SYSOK;
+	}
+
+	if(!deadline_ms)
+		deadline_ms = period_ms;
+
+	period = sleep_to_slice(period_ms);
+	budget = sleep_to_slice(budget_ms);
+	deadline = sleep_to_slice(deadline_ms);
+
+	if(!budget || budget > deadline || deadline > period)
+		return ERR_RT_PARAM;
+
+	/* sum the density of every other admitted proc */
+	for(i=0 ; i<PROC_SZ ; i++)
+	{
+		if(&proc_table[i] == p) continue;
+		if(!rt_member(&proc_table[i])) continue;
+
+		util += (proc_table[i].rt_budget * RT_UTIL_MAX) / proc_table[i].rt_deadline;
+	}
+
+	if(util + (budget * RT_UTIL_MAX) / deadline > RT_UTIL_MAX)
+		return ERR_RT_ADMIT;
+
+	/* release the first job now */
+	p->sched_class = SCHED_CLASS_RT;
+	p->rt_period = period;
+	p->rt_budget = budget;
+	p->rt_deadline = deadline;
+	p->rt_release = rt_ticks;
+	p->rt_abs_deadline = rt_ticks + deadline;
+	p->rt_used = 0;
+	p->rt_overruns = 0;
+	p->rt_misses = 0;
+
+	return SYSOK;
+}
+
+/*
+* rt_ready
+*
+* @desc:	puts proc pcb in the rt_q after every proc with the same or an earlier deadline
+*
+* @param:	p		proc pcb to place in the rt_q
+*/
+void rt_ready(pcb_t *p)
+{
+	pcb_t *tmp = rt_q;
+
+	p->next = NULL;
+
+	/* add proc to head */
+	if(!tmp || p->rt_abs_deadline < tmp->rt_abs_deadline)
+	{
+		p->next = rt_q;
+		rt_q = p;
+		return;
+	}
+
+	/* add proc to body/tail */
+	while(tmp->next && tmp->next->rt_abs_deadline <= p->rt_abs_deadline)
+		tmp = tmp->next;
+
+	p->next = tmp->next;
+	tmp->next = p;
+}
+
+/*
+* rt_next
+*
+* @desc:	pop the head of the rt_q
+*
+* @output:	p		released proc with the earliest deadline
+*/
+pcb_t* rt_next(void)
+{
+	pcb_t *p = rt_q;
+	if(p) rt_q = p->next;
+	return p;
+}
+
+/*
+* rt_count
+*
+* @desc:	count the number of pcb in the rt_q
+*/
+int rt_count(void)
+{
+	int cnt=0;
+	pcb_t *tmp;
+
+	for(tmp = rt_q ; tmp ; tmp = tmp->next)
+		cnt++;
+
+	return cnt;
+}
+
+/*
+* rt_admitted
+*
+* @desc:	count the number of proc in the real-time class, whether released or waiting
+*/
+int rt_admitted(void)
+{
+	int cnt=0,i;
+
+	for(i=0 ; i<PROC_SZ ; i++)
+	{
+		if(rt_member(&proc_table[i]))
+			cnt++;
+	}
+
+	return cnt;
+}
+
+/*
+* rt_wait
+*
+* @desc:	completes the current job of a proc and holds it until its next release
+*
+* @param:	p		real-time proc whose job has completed or been throttled
+*
+* @note:	releases are kept on a fixed grid of rt_release + n * rt_period, hence the period
+*		does not drift with the time spent in each job
+*/
+void rt_wait(pcb_t *p)
+{
+	pcb_t *tmp = rt_wait_q;
+
+	if(rt_ticks > p->rt_abs_deadline)
+		p->rt_misses++;
+
+	p->rt_release += p->rt_period;
+
+	/* job is late for its next release, release it right away */
+	if(p->rt_release <= rt_ticks)
+	{
+		p->rt_abs_deadline = p->rt_release + p->rt_deadline;
+		p->rt_used = 0;
+		p->state = READY_STATE;
+		rt_ready(p);
+		return;
+	}
+
+	p->state = RT_WAIT_STATE;
+	p->next = NULL;
+
+	/* add proc to head */
+	if(!tmp || p->rt_release < tmp->rt_release)
+	{
+		p->next = rt_wait_q;
+		rt_wait_q = p;
+		return;
+	}
+
+	/* add proc to body/tail */
+	while(tmp->next && tmp->next->rt_release <= p->rt_release)
+		tmp = tmp->next;
+
+	p->next = tmp->next;
+	tmp->next = p;
+}
+
+/*
+* rt_tick
+*
+* @desc:	advance the real-time clock and move every job whose release is due to the rt_q
+*/
+void rt_tick(void)
+{
+	pcb_t *p;
+
+	rt_ticks++;
+
+	while(rt_wait_q && rt_wait_q->rt_release <= rt_ticks)
+	{
+		p = rt_wait_q;
+		rt_wait_q = rt_wait_q->next;
+
+		p->rt_abs_deadline = p->rt_release + p->rt_deadline;
+		p->rt_used = 0;
+		p->state = READY_STATE;
+		rt_ready(p);
+	}
+}
+
+/*
+* rt_charge
+*
+* @desc:	charge the elapsed timer tick against the budget of the running real-time proc
+*
+* @param:	p		real-time proc that was running when the timer fired
+*
+* @output:	TRUE		proc overran its budget, its job has been ended and the proc has been queued 
+*				for its next release
+*		FALSE		proc still has budget left
+*/
+Bool rt_charge(pcb_t *p)
+{
+	p->rt_used++;
+	if(p->rt_used < p->rt_budget)
+		return FALSE;
+
+	p->rt_overruns++;
+	rt_wait(p);
+	return TRUE;
+}
+
+/*
+* puts_rt_q
+*
+* @desc:	output all rt queue proc pid with their absolute deadline, and all waiting proc with their next release
+*/
+void puts_rt_q()
+{
+	pcb_t *tmp;
+
+	kprintf("rt_q: ");
+	for(tmp = rt_q ; tmp ; tmp = tmp->next)
+		kprintf("%d(%d) ", tmp->pid, tmp->rt_abs_deadline);
+	kprintf("\n");
+
+	kprintf("rt_wait_q: ");
+	for(tmp = rt_wait_q ; tmp ; tmp = tmp->next)
+		kprintf("%d(%d) ", tmp->pid, tmp->rt_release);
+	kprintf("\n");
+}
@@ -0,0 +1,256 @@
+/* Shared Memory
+ *
+ * This is the shared memory unit, named segments are backed by page frames
+ * from the page pool and mapped by a page table of their own, which is
+ * installed at the same virtual address in every process that attaches the
+ * segment. Segments are reference counted by their attached processes.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+#include <i386.h>
+
+typedef struct shm shm_t;
+struct shm
+{
+	int key;			/* segment name 					*/
+	unsigned int size;		/* segment size, rounded up to a page 			*/
+	unsigned int *pt;		/* page table mapping the segment, NULL for a free slot */
+	int refs;			/* number of proc the segment is attached to 		*/
+};
+
+static shm_t shm_table[SHM_SZ];
+
+#define shm_va(i)	(VM_SHM_BASE + (i) * VM_SHM_MAX)
+#define shm_bit(i)	(BIT_ON << (i))
+
+/* index of the segment mapped at va, SHM_SZ when va is outside of the shared memory window */
+#define shm_index(va)	((unsigned int)(va) >= VM_SHM_BASE && (unsigned int)(va) < shm_va(SHM_SZ) ? \
+			 ((unsigned int)(va) - VM_SHM_BASE) / VM_SHM_MAX : SHM_SZ)
+
+
+/*
+* shm_find
+*
+* @desc:	get the segment slot holding the named segment
+*
+* @output:	i		slot index, SHM_SZ when no segment has the name
+*/
+static int shm_find(int key)
+{
+	int i;
+
+	for(i=0 ; i<SHM_SZ ; i++)
+	{
+		if(shm_table[i].pt && shm_table[i].key == key)
+			break;
+	}
+
+	return i;
+}
+
+/*
+* shm_free
+*
+* @desc:	release the page frames and page table of a segment, and free its slot
+*/
+static void shm_free(shm_t *s)
+{
+	unsigned int i;
+
+	for(i=0 ; i<s->size / NBPG ; i++)
+		frame_free((void *) (s->pt[i] & PG_FRAME));
+
+	frame_free(s->pt);
+	s->pt = NULL;
+	s->refs = 0;
+}
+
+/*
+* shm_create
+*
+* @desc:	create a named segment and attach it to proc
+*
+* @param:	p		proc creating the segment
+*		key		segment name, unique among existing segments
+*		size		segment size, rounded up to a page
+*
+* @output:	addr		virtual address of the segment, NULL when the name is taken, size is 0 or larger
+*				than VM_SHM_MAX, or there is no free slot or page frame left
+*
+* @note:	every page is committed and zero filled up front, so a segment never faults
+*/
+void *shm_create(pcb_t *p, int key, unsigned int size)
+{
+	int i;
+	unsigned int pg;
+	unsigned int *frame;
+	shm_t *s;
+
+	if(!size || size > VM_SHM_MAX) return NULL;
+	if(shm_find(key) != SHM_SZ) return NULL;
+
+	for(i=0 ; i<SHM_SZ && shm_table[i].pt ; i++);
+	if(i == SHM_SZ) return NULL;
+
+	s = &shm_table[i];
+	s->pt = frame_alloc();
+	if(!s->pt) return NULL;
+
+	s->key = key;
+	s->size = 0;
+	s->refs = 0;
+
+	for(pg=0 ; pg<PG_ROUND(size) / NBPG ; pg++)
+	{
+		frame = frame_alloc();
+		if(!frame)
+		{
+			shm_free(s);
+			return NULL;
+		}
+
+		s->pt[pg] = (unsigned int) frame | PG_P | PG_RW;
+		s->size += NBPG;
+	}
+
+	return shm_attach(p, key);
+}
+
+/*
+* shm_attach
+*
+* @desc:	map a named segment into the address space of proc
+*
+* @param:	p		proc attaching the segment
+*		key		segment name
+*
+* @output:	addr		virtual address of the segment, NULL when no segment has the name
+*
+* @note:	attaching a segment the proc already holds returns the same address and takes no reference
+*/
+void *shm_attach(pcb_t *p, int key)
+{
+	int i = shm_find(key);
+
+	if(i == SHM_SZ) return NULL;
+
+	if(!(p->shm_mask & shm_bit(i)))
+	{
+		p->shm_mask |= shm_bit(i);
+		shm_table[i].refs++;
+		vm_map(p, shm_va(i), shm_table[i].pt);
+	}
+
+	return (void *) shm_va(i);
+}
+
+/*
+* shm_detach
+*
+* @desc:	unmap a segment from the address space of proc, the segment is released with its last reference
+*
+* @param:	p		proc detaching the segment
+*		addr		virtual address returned by shm_create() or shm_attach()
+*
+* @output:	SYSOK		segment detached
+*		SYSERR		proc has no segment attached at addr
+*/
+int shm_detach(pcb_t *p, void *addr)
+{
+	int i = shm_index(addr);
+
+	if(i == SHM_SZ || !(p->shm_mask & shm_bit(i))) return SYSERR;
+
+	p->shm_mask &= ~shm_bit(i);
+	vm_map(p, shm_va(i), NULL);
+
+	if(--shm_table[i].refs == 0)
+		shm_free(&shm_table[i]);
+
+	return SYSOK;
+}
+
+/*
+* shm_release
+*
+* @desc:	detach every segment proc holds, called before its address space is freed
+*/
+void shm_release(pcb_t *p)
+{
+	int i;
+
+	for(i=0 ; i<SHM_SZ && p->shm_mask ; i++)
+	{
+		if(p->shm_mask & shm_bit(i))
+			shm_detach(p, (void *) shm_va(i));
+	}
+}
+
+/*
+* shm_fork
+*
+* @desc:	attach every segment the parent holds to its clone, at the same addresses
+*/
+void shm_fork(pcb_t *child, pcb_t *parent)
+{
+	int i;
+
+	for(i=0 ; i<SHM_SZ ; i++)
+	{
+		if(parent->shm_mask & shm_bit(i))
+		{
+			child->shm_mask |= shm_bit(i);
+			shm_table[i].refs++;
+			vm_map(child, shm_va(i), shm_table[i].pt);
+		}
+	}
+}
+
+/*
+* shm_mapped
+*
+* @desc:	check a range lies within a single segment attached to proc
+*/
+Bool shm_mapped(pcb_t *p, unsigned int va, int len)
+{
+	int i = shm_index(va);
+
+	if(i == SHM_SZ || !(p->shm_mask & shm_bit(i))) return FALSE;
+
+	return len > 0 && va + len <= shm_va(i) + shm_table[i].size && va + len > va;
+}
+
+/*
+* puts_shm
+*
+* @desc:	output the name, size and reference count of every segment
+*/
+void puts_shm()
+{
+	int i;
+
+	kprintf("shm: ");
+	for(i=0 ; i<SHM_SZ ; i++)
+	{
+		if(shm_table[i].pt)
+			kprintf("%d(%d bytes, %d refs) ", shm_table[i].key, shm_table[i].size, shm_table[i].refs);
+	}
+	kprintf("\n");
+}
@@ -22,6 +22,7 @@
  */
 
 #include <xeroskernel.h>
+#include <xeroslib.h>
 
 /* Your code goes here */
 extern long freemem;
@@ -103,30 +104,34 @@ int sighigh(pcb_t *p)
 *
 * @output:	returns the following values
 *		SIG_SUCCESS		signal has successfully been delivered onto proc stack
+*		ERR_SIGNAL_STACK	proc stack has no room left for the signal stack
+*
+* @note:	the signal stack is built in the kernel and copied onto the proc stack with copy_to_user()
 */
 int sigdeliver(int pid, int sig_no)
 {	
 	int i;
 	unsigned int mem,bit_mask=BIT_ON;
 	pcb_t *p = NULL;
-	sig_arg_t *sig_args = NULL;
-	context_frame_t *frame = NULL;
+	sig_arg_t sig_args;
+	context_frame_t frame;
 
 	if(sig_no < 0 || sig_no >= SIG_SZ) return ERR_SIGNAL_SIG_NO;
 	p = get_proc(pid);
 	if(!p) return ERR_SIGNAL_PROC_NO;
 
-	/* get user proc stack pointer */
-	mem = p->esp;
+	/* get user proc stack pointer, the signal stack goes right below it */
+	mem = p->esp - sizeof(sig_arg_t) - sizeof(context_frame_t);
+	if(!validate_range(p, (void *) mem, sizeof(sig_arg_t) + sizeof(context_frame_t)))
+		return ERR_SIGNAL_STACK;
 
 	/* setup sigtramp arguments */
-	mem -= sizeof(sig_arg_t);
-	sig_args = (sig_arg_t*) mem;
-	sig_args->rc = p->rc;
-	sig_args->osp = p->esp;
-	sig_args->cntx = p->esp;
-	sig_args->handler = p->sig_table[sig_no];
-	sig_args->sig_ignore_mask = p->sig_ignore_mask;		/* old sig_ignore_mask of the stack below */
+	memset(&sig_args, 0, sizeof(sig_arg_t));
+	sig_args.rc = p->rc;
+	sig_args.osp = p->esp;
+	sig_args.cntx = p->esp;
+	sig_args.handler = p->sig_table[sig_no];
+	sig_args.sig_ignore_mask = p->sig_ignore_mask;		/* old sig_ignore_mask of the stack below */
 
 	/* toggle off all bits for same or lower level signals */
 	bit_mask = BIT_ON;
@@ -138,13 +143,15 @@ int sigdeliver(int pid, int sig_no)
 	p->sig_ignore_mask &= ~bit_mask;
 
 	/* setup sigtramp frame */
-	mem -= sizeof(context_frame_t);
-	frame = (context_frame_t*) mem;
-	frame->iret_cs = getCS();
-	frame->iret_eip = (unsigned int) sigtramp;
-    	frame->esp = mem;
-	frame->ebp = frame->esp;
-	frame->eflags = 0x00003200;
+	memset(&frame, 0, sizeof(context_frame_t));
+	frame.iret_cs = getCS();
+	frame.iret_eip = (unsigned int) sigtramp;
+    	frame.esp = mem;
+	frame.ebp = frame.esp;
+	frame.eflags = 0x00003200;
+
+	copy_to_user(p, (void *) (mem + sizeof(context_frame_t)), &sig_args, sizeof(sig_arg_t));
+	copy_to_user(p, (void *) mem, &frame, sizeof(context_frame_t));
 
 	p->esp = mem;
 	
@@ -174,7 +181,8 @@ int siginstall(pcb_t *p, int sig_no, void (*new_handler)(void *), void (**old_ha
 	if(new_handler > freemem) return ERR_SIGNAL_HANDLER;
 
 	/* save old signal handler */
-	*old_handler = p->sig_table[sig_no];
+	if(copy_to_user(p, old_handler, &(p->sig_table[sig_no]), sizeof(void *)) != sizeof(void *))
+		return ERR_SIGNAL_HANDLER;
 
 	p->sig_table[sig_no] = new_handler;
 
@@ -226,10 +234,10 @@ int signal(int pid, int sig_no)
 	if(p->state == SLEEP_STATE)
 		wake_early(p);
 
-	/* check if proc is waiting for kbd */
+	/* check if proc is waiting on a device */
 	if(p->state == BLOCK_ON_DEV_STATE)
 	{
-		kbd_dequeue();		
+		di_cancel(p);		
 		p->rc = ERR_SIGNAL_UNBLOCK_SYSCALL;
 	}
 
@@ -242,9 +250,9 @@ int signal(int pid, int sig_no)
 		{
 			case BLOCK_ON_RECV_STATE:
 				/* check if ipc_recv is receive any */
-				if(comm && *(comm->pid_ptr))
+				if(comm && comm->pid)
 				{
-					ipc = get_proc(*(comm->pid_ptr));
+					ipc = get_proc(comm->pid);
 					p = unblock(&(ipc->blocked_receivers), pid);
 				}
 
@@ -279,6 +287,10 @@ int signal(int pid, int sig_no)
 	/* enable proc target_mask */
 	p->sig_pend_mask |= bit_mask;
 
+	/* check if proc is polling, the poll reports the signal or is interrupted by it */
+	if(p->state == BLOCK_ON_POLL_STATE)
+		poll_signal(p);
+
 	return SIG_SUCCESS;
 }
 
@@ -23,6 +23,7 @@
 #include <xeroskernel.h>
 
 pcb_t *sleep_q;
+unsigned int clock_hz = CLOCK_DIVISOR;	/* timer ticks per second */
 static unsigned int slice_elapsed = 0;	/* delta slice for the timer hardware */
 
 /*
@@ -32,16 +33,51 @@ static unsigned int slice_elapsed = 0;	/* delta slice for the timer hardware */
 *
 * @param:	ms		time in milliseconds
 *
-* @output:	slice		millisecond in milliseconds
+* @output:	slice		number of time slices, rounded up
 *
-* @note:	the quantum of a time slice is CLOCK_DIVISOR / 10
+* @note:	a time slice is 1000 / clock_hz milliseconds
 */
 unsigned int sleep_to_slice (unsigned int ms)
 {
-	unsigned int slice = (ms / 10) + (ms % 10 ? 1 : 0);
+	unsigned int slice = (ms / 1000) * clock_hz;
+
+	/* remainder is converted separately so ms * clock_hz does not overflow */
+	ms %= 1000;
+	slice += (ms * clock_hz) / 1000 + ((ms * clock_hz) % 1000 ? 1 : 0);
 	return slice;
 }
 
+/*
+* clock_rate
+*
+* @desc:	reprograms the timer to interrupt at the provided rate
+*
+* @param:	hz		new tick rate in the range [CLOCK_HZ_MIN, CLOCK_HZ_MAX]
+*
+* @output:	old_hz		previous tick rate
+*		SYSERR		rate out of range, or a real-time proc is admitted with periods in ticks
+*
+* @note:	sleeping procs are rescaled to the new tick length so they wake at the same time
+*/
+int clock_rate(unsigned int hz)
+{
+	pcb_t *tmp;
+	unsigned int old_hz = clock_hz;
+
+	if(hz < CLOCK_HZ_MIN || hz > CLOCK_HZ_MAX) return SYSERR;
+	if(rt_admitted()) return SYSERR;
+
+	/* rescale the delta list, rounding up so no proc wakes early */
+	for(tmp = sleep_q ; tmp ; tmp = tmp->next)
+		tmp->delta_slice = (tmp->delta_slice * hz + old_hz - 1) / old_hz;
+	slice_elapsed = (slice_elapsed * hz) / old_hz;
+
+	clock_hz = hz;
+	initPIT(hz);
+
+	return old_hz;
+}
+
 /*
 * sleep
 *
@@ -113,6 +149,21 @@ unsigned int sleep (pcb_t *p)
 	return 0;
 }
 
+/*
+* sleep_done
+*
+* @desc:	put a proc whose sleeping time is up back on the ready_q
+*
+* @note:	a proc polling with a timeout sleeps too, its poll completes with nothing ready
+*/
+static void sleep_done(pcb_t *p)
+{
+	if(p->state == BLOCK_ON_POLL_STATE)
+		poll_timeout(p);
+	else
+		ready(p);
+}
+
 /*
 * wake
 *
@@ -130,7 +181,7 @@ void wake ()
 	/* put sleep_q head back in ready_q */
     	pcb_t *p = sleep_q;
    	sleep_q = sleep_q->next;
-	ready(p);
+	sleep_done(p);
 
 	/* put back any proc whose delta_slice is 0 and trails the head */
 	while(sleep_q)
@@ -141,7 +192,7 @@ void wake ()
 			p->rc = p->delta_slice;
 			sleep_q = sleep_q->next;
 
-			ready(p);
+			sleep_done(p);
 		}
 		else			
 			break;
@@ -149,18 +200,21 @@ void wake ()
 }
 
 /*
-* wake_early
+* unsleep
 *
-* @desc:	wake a sleeping proc prematurely
+* @desc:	take a sleeping proc off the sleep queue ahead of its sleeping time
 * 
-* @param:	p		sleeping proc to be woken ahead of its sleeping time
+* @param:	p		sleeping proc to be taken off the sleep queue
+*
+* @output:	slice		time slices the proc had left to sleep
 */
-void wake_early(pcb_t *p)
+unsigned int unsleep(pcb_t *p)
 {
 	pcb_t *tmp = sleep_q;
 	int cnt=0;
 
-	if(!p) return;
+	if(!p || !sleep_q) return 0;
+
 	if(sleep_q->pid == p->pid)
 	{
 		sleep_q = sleep_q->next;
@@ -172,11 +226,7 @@ void wake_early(pcb_t *p)
 		if(sleep_q)
 			sleep_q->delta_slice += p->delta_slice;
 
-		/* set rc as leftover delta_slice and put back in ready_q */
-		p->rc = p->delta_slice;
-		p->state = READY_STATE;
-		ready(p);
-		return;
+		return p->delta_slice;
 	}
 
         while(tmp && tmp->next) 
@@ -187,23 +237,35 @@ void wake_early(pcb_t *p)
                 if(tmp->next->pid == p->pid)
                 {
                         tmp->next = tmp->next->next;
-			
+
 			/* update the delta_slice for the proc after the awaken proc */
 			if(tmp->next)
 				tmp->next->delta_slice += p->delta_slice;
 
-			/* set rc as leftover delta_slice and put back in ready_q */
-			p->rc = cnt + p->delta_slice;
-			p->state = READY_STATE;	
-			ready(p);
-			return;
+			return cnt + p->delta_slice;
                 }
-
                 tmp = tmp->next;
         }
 
 	/* code should not reach this point, if a proc is in the sleep_state, then it must be found in the sleep_q */
-	return;
+	return 0;
+}
+
+/*
+* wake_early
+*
+* @desc:	wake a sleeping proc prematurely
+* 
+* @param:	p		sleeping proc to be woken ahead of its sleeping time
+*/
+void wake_early(pcb_t *p)
+{
+	if(!p) return;
+
+	/* set rc as leftover delta_slice and put back in ready_q */
+	p->rc = unsleep(p);
+	p->state = READY_STATE;
+	ready(p);
 }
 
 /*
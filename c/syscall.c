@@ -71,6 +71,63 @@ int syscreate(void (*func)(void), int stack)
 	return syscall(CREATE, func, stack);
 }
 
+/*
+* sysfork
+*
+* @desc:	signals a fork process interrupt, the current process is cloned with its stack, heap arena, 
+*		signal handlers and file descriptors
+*
+* @output:	rc		pid of the clone in the parent, 0 in the clone, -1 when the clone can not be created
+*
+* @note:	the clone shares every page with its parent copy-on-write, a page is only copied on the first
+*		write to it by either process
+*/
+int sysfork(void)
+{
+	return syscall(FORK);
+}
+
+/*
+* syslogread
+*
+* @desc:	signals a request for the oldest unread kernel log records
+*
+* @param:	buf		buffer to be filled with records, one "<level>[ticks] text" line each
+*		len		buffer length
+*
+* @output:	rc		number of bytes read, 0 when every record has been read
+*				-1	buf is not a valid buffer
+*
+* @note:	records are read once, by whichever proc reads them first
+*/
+int syslogread(void *buf, int len)
+{
+	return syscall(SYSLOG_READ, buf, len);
+}
+
+/*
+* syspoll
+*
+* @desc:	signals a request to wait for any entry of a set to be ready
+*
+* @param:	set		entries to wait for, POLL_FD for an open fd, POLL_MSG for a proc blocked sending to the
+*				current proc, POLL_SIG for a pending signal, at most POLL_SZ entries
+*		n		number of entries
+*		timeout_ms	time to wait in milliseconds, 0 to only check the set, negative to wait without a timeout
+*
+* @output:	rc		returns the status of the request
+*				n	number of entries with revents set
+*				0	timeout expired with no entry ready
+*				-1	set is not a valid buffer, or n is out of range
+*				ERR_SIGNAL_UNBLOCK_SYSCALL	a signal that no POLL_SIG entry waits for was pended
+*
+* @note:	a ready POLL_MSG entry is taken with sysrecv(), which then does not block
+*/
+int syspoll(pollfd_t *set, int n, int timeout_ms)
+{
+	return syscall(POLL, set, n, timeout_ms);
+}
+
 /*
 * sysyield
 *
@@ -81,6 +138,69 @@ void sysyield()
 	syscall(YIELD);
 }
 
+/*
+* sysyield_to
+*
+* @desc:	signals a directed yield, the target proc runs next with the remaining quantum of the current proc
+*
+* @param:	pid		pid of a ready proc to run next
+*
+* @output:	rc		returns the status of the yield
+*				0	target proc has been placed at the head of the ready_q
+*				-1	target proc is not ready, is real-time, or is the current proc
+*/
+int sysyield_to(unsigned int pid)
+{
+	return syscall(YIELD_TO, pid);
+}
+
+/*
+* sysquantum
+*
+* @desc:	signals a new quantum for the current proc
+*
+* @param:	milliseconds	time the proc may run before it is preempted, at most QUANTUM_MS_MAX, 0 restores the
+*				quantum of its scheduler level
+*
+* @output:	rc		returns the previous quantum in milliseconds, 0 if the level quantum was in use, -1 when
+*				milliseconds is above QUANTUM_MS_MAX and the quantum is left as it was
+*/
+int sysquantum(unsigned int milliseconds)
+{
+	return syscall(QUANTUM, milliseconds);
+}
+
+/*
+* sysclock
+*
+* @desc:	signals the timer to be reprogrammed to a new tick rate
+*
+* @param:	hz		new tick rate, in the range [CLOCK_HZ_MIN, CLOCK_HZ_MAX]
+*
+* @output:	rc		returns the previous tick rate, or -1 if the rate is out of range or a real-time proc is admitted
+*/
+int sysclock(unsigned int hz)
+{
+	return syscall(CLOCK, hz);
+}
+
+/*
+* sysschedhint
+*
+* @desc:	signals a scheduler hint for a proc
+*
+* @param:	pid		pid of the proc to be hinted
+*		hint		SCHED_HINT_LATENCY, SCHED_HINT_NORMAL or SCHED_HINT_BATCH
+*
+* @output:	rc		returns the status of the hint
+*				0	hint has been applied
+*				-1	invalid pid or hint
+*/
+int sysschedhint(unsigned int pid, unsigned int hint)
+{
+	return syscall(SCHED_HINT, pid, hint);
+}
+
 /*
 * sysstop
 *
@@ -108,11 +228,15 @@ unsigned int sysgetpid(void)
 *
 * @desc:	signals a synchronous kernel console output message
 *
-* @param:	str		string message to display on console
+* @param:	str		string message to display on console, at most PUTS_SZ-1 characters are shown
+*
+* @output:	rc		returns the status of the request
+*				n	length of the string shown
+*				-1	str is not a string the proc may pass in
 */
-void sysputs( char *str )
+int sysputs( char *str )
 {
-	syscall(PUTS, str);
+	return syscall(PUTS, str);
 }
 
 /*
@@ -129,6 +253,88 @@ unsigned int syssleep( unsigned int milliseconds )
 	return syscall(SLEEP, milliseconds);
 }
 
+/*
+* sysmalloc
+*
+* @desc:	signals the heap arena of the current process to grow
+*
+* @param:	size		number of bytes to add, rounded up to whole pages, 0 only returns the end of the arena
+*
+* @output:	rc		start of the added range, which is the previous end of the arena, 0 when the arena
+*				would exceed VM_HEAP_MAX
+*
+* @note:	this is the kernel half of malloc() in libxc, which carves blocks out of the arena itself
+*/
+unsigned int sysmalloc(unsigned int size)
+{
+	return syscall(MALLOC, size);
+}
+
+/*
+* sysfree
+*
+* @desc:	signals the heap arena of the current process to be cut back
+*
+* @param:	ptr		new end of the arena, rounded up to a page, everything above is released
+*
+* @output:	rc		0 on success, -1 when ptr is outside of the arena
+*
+* @note:	the whole arena is released when the process stops
+*/
+int sysfree(void *ptr)
+{
+	return syscall(FREE, ptr);
+}
+
+/*
+* sysshmcreate
+*
+* @desc:	signals the kernel to create a named shared memory segment and attach it to the current process
+*
+* @param:	key		segment name, unique among existing segments
+*		size		segment size, rounded up to whole pages, at most VM_SHM_MAX
+*
+* @output:	rc		address of the segment, 0 when the name is taken or no memory is left
+*
+* @note:	the segment is mapped at the same address in every process attaching it, so pointers 
+*		into the segment may be shared
+*/
+void *sysshmcreate(int key, unsigned int size)
+{
+	return (void *) syscall(SHM_CREATE, key, size);
+}
+
+/*
+* sysshmattach
+*
+* @desc:	signals the kernel to attach an existing shared memory segment to the current process
+*
+* @param:	key		segment name
+*
+* @output:	rc		address of the segment, 0 when no segment has the name
+*/
+void *sysshmattach(int key)
+{
+	return (void *) syscall(SHM_ATTACH, key);
+}
+
+/*
+* sysshmdetach
+*
+* @desc:	signals the kernel to detach a shared memory segment from the current process
+*
+* @param:	addr		segment address from sysshmcreate() or sysshmattach()
+*
+* @output:	rc		0 on success, -1 when no segment is attached at addr
+*
+* @note:	the segment is released once every process has detached it, segments are detached when
+*		a process stops
+*/
+int sysshmdetach(void *addr)
+{
+	return syscall(SHM_DETACH, addr);
+}
+
 /*
 * syssend
 *
@@ -167,6 +373,87 @@ int sysrecv(unsigned int *from_pid, void *buffer, int buffer_len)
 	return syscall(RECV, from_pid, buffer, buffer_len);
 }
 
+/*
+* sysschedinfo
+*
+* @desc:	signals a request for the scheduler policy and settings
+*
+* @param:	info		buffer to be filled with the scheduler settings
+*
+* @output:	rc		returns the status of the request
+*				0	info has been filled in
+*				-1	info is not memory the process may pass in
+*/
+int sysschedinfo(sched_info_t *info)
+{
+	return syscall(SCHED_INFO, info);
+}
+
+/*
+* sysmemstats
+*
+* @desc:	signals a request for the kernel allocator counters
+*
+* @param:	stats		buffer to be filled with the counters, the free list histogram and the stack cache
+*				hit and miss counters
+*
+* @output:	rc		returns the status of the request
+*				0	stats has been filled in
+*				-1	stats is not a valid buffer
+*/
+int sysmemstats(kmem_stats_t *stats)
+{
+	return syscall(MEM_STATS, stats);
+}
+
+/*
+* sysmemtrace
+*
+* @desc:	signals a request to start or stop tracing kmalloc and kfree, and to get the latest trace records
+*
+* @param:	on		TRUE to start tracing and clear the old records, FALSE to stop, -1 to leave tracing as is
+*		buf		buffer for the records, oldest first, NULL to get none
+*		n		number of records buf holds, at most KMEM_TRACE_SZ are copied
+*
+* @output:	rc		returns the number of records copied into buf, -1 when n is negative or buf is not a
+*				valid buffer
+*/
+int sysmemtrace(int on, kmem_trace_t *buf, int n)
+{
+	return syscall(MEM_TRACE, on, buf, n);
+}
+
+/*
+* sysrtset
+*
+* @desc:	signals a request to run the current proc as a periodic real-time proc
+*
+* @param:	period_ms	period in milliseconds, 0 returns the proc to time sharing
+*		budget_ms	execution budget per period in milliseconds
+*		deadline_ms	deadline relative to each release in milliseconds, 0 uses the period
+*
+* @output:	rc		returns the status of the request
+*				0	proc has been admitted as real-time
+*				-1	invalid period, budget or deadline
+*				-2	proc was refused by admission control
+*/
+int sysrtset(unsigned int period_ms, unsigned int budget_ms, unsigned int deadline_ms)
+{
+	return syscall(RT_SET, period_ms, budget_ms, deadline_ms);
+}
+
+/*
+* sysrtwait
+*
+* @desc:	signals the completion of the current real-time job, the proc is suspended until its next release
+*
+* @output:	rc		returns the number of budget overruns of the proc, or -1 if the proc is not real-time
+*/
+int sysrtwait(void)
+{
+	return syscall(RT_WAIT);
+}
+
 /*
 * syssighandler
 *
@@ -232,11 +519,13 @@ int syssigwait(void)
 *
 * @desc:	signals a device to be opened
 *
-* @param:	device_no	device number to device
+* @param:	device_no	device major number, or'ed with DEV_MINOR(unit) for devices with several units
 *
 * @output:	rc		returns the status of the device call
-*				0	successful device open
+*				fd	file descriptor of the opened device
 *				-1	device was not able to be opened
+*
+* @note:	a device may be open through any number of file descriptors and procs at once
 */
 int sysopen(int device_no)
 {
@@ -268,10 +557,12 @@ int sysclose(int fd)
 *		buff		proc buffer to be written to device
 *		buflen		length of data to be written to device
 *
-* @output:	rc		returns the status of the device call
+* @output:	rc		number of bytes written
 *				-1	device was not able to be written to
 *
-* @note:	this call is not supported by the device, only -1 is returned
+* @note:	the console and serial devices support writes, console output reaches the screen by the next clock
+*		tick, a serial write blocks until all of buff has been queued for transmission, behind the serial
+*		writes of other procs already blocked
 */
 int syswrite(int fd, void *buff, int bufflen)
 {
@@ -288,8 +579,10 @@ int syswrite(int fd, void *buff, int bufflen)
 *		buflen		length of data to be read from device
 *
 * @output:	rc		returns the status of the device call
-*				0	proc buffer has been filled with device data
-*				-1	device was not able to be written to
+*				n	number of bytes read into the proc buffer, 0 at eof
+*				0	O_ASYNC read has been queued, see GET_ASYNC
+*				BLOCKERR	O_NONBLOCK fd has no data ready
+*				-1	device was not able to be read from
 */
 int sysread(int fd, void *buff, int bufflen)
 {
@@ -302,7 +595,14 @@ int sysread(int fd, void *buff, int bufflen)
 * @desc:	signal a device-specific command for device manipulation
 *	
 * @param:	fd		fd index into proc fd_table for opened device
-*		command		device specific command
+*		command		device specific command, or one of the fd commands
+*				SET_FLAGS	set O_NONBLOCK or O_ASYNC for the fd, fails while an O_ASYNC read is pending
+*				GET_FLAGS	get the fd flags
+*				SET_ASYNC_SIG	signal raised when an O_ASYNC read completes, -1 for none
+*				GET_ASYNC	get the result of the last O_ASYNC read, BLOCKERR while pending
+*				BLK_SEEK	set the fd offset of a block device
+*				BLK_SIZE	get the size of a block device in bytes
+*				BLK_SYNC	write back the dirty cached blocks of a block device
 *
 * @output:	rc		returns the status of the device call
 *				0	device has been successfully manipulated
@@ -316,3 +616,23 @@ int sysioctl(int fd, unsigned long command, ...)
 
 	return syscall(DEV_IOCTL, fd, command, eof);
 }
+
+/*
+* syspipe
+*
+* @desc:	signals a pipe to be created
+*
+* @param:	fds		array of two fds, receives the read end fd then the write end fd
+*
+* @output:	rc		returns the status of the device call
+*				0	pipe has been created, both ends are open
+*				-1	fds is not a valid buffer, fewer than two fds are free, or no pipe is left
+*
+* @note:	reads block until at least one byte has been written and return 0 once no fd holds the write end,
+*		writes block until all of the buffer has been taken and return -1 once no fd holds the read end. 
+*		O_NONBLOCK is honoured by both ends
+*/
+int syspipe(int *fds)
+{
+	return syscall(DEV_PIPE, fds);
+}
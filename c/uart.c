@@ -0,0 +1,463 @@
+/* Serial Device Driver
+ *
+ * This is the 16550 serial device driver for COM1. Both fifos are enabled,
+ * bytes move between the fifos and a pair of rings on interrupts, and the
+ * rings move bytes to and from proc buffers.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+#include <uart.h>
+
+typedef struct uart_ring uart_ring_t;	/* bytes indexed by free running counters modulo UART_RING_SZ */
+struct uart_ring
+{
+	unsigned char buf[UART_RING_SZ];
+	unsigned int head;		/* bytes put in 	*/
+	unsigned int tail;		/* bytes taken out 	*/
+};
+
+typedef struct uarti uarti_t;		/* queued read or blocked write */
+struct uarti
+{
+	pcb_t* p;
+	fd_t* f;
+	void* buf;
+	int buflen;
+	int bufi;
+	uarti_t* next;
+};
+
+static uart_ring_t uart_rx;
+static uart_ring_t uart_tx;
+static unsigned int uart_lost = 0;	/* bytes received on a full ring 	*/
+static unsigned char uart_ier = 0;	/* interrupts currently enabled 	*/
+static pcb_t *uart_reader = NULL;	/* proc with a read queued 		*/
+static uarti_t *uart_wq = NULL;		/* blocked writes, in the order they were made */
+static uarti_t uart_rio;
+
+#define ring_cnt(r)	((r)->head - (r)->tail)
+
+
+/*
+* ring_in
+*
+* @desc:	copy a proc buffer into a ring, through the proc's address space
+*
+* @output:	n		number of bytes copied, limited by the free space of the ring
+*/
+static int ring_in(uart_ring_t *r, pcb_t *p, unsigned char *buf, int len)
+{
+	unsigned int n, start;
+	int cnt = 0;
+
+	while(cnt < len && ring_cnt(r) < UART_RING_SZ)
+	{
+		start = r->head & UART_RING_MASK;
+		n = UART_RING_SZ - ring_cnt(r);
+		if(n > UART_RING_SZ - start)
+			n = UART_RING_SZ - start;
+		if(n > len - cnt)
+			n = len - cnt;
+
+		vm_copy(NULL, &r->buf[start], p, buf + cnt, n);
+		r->head += n;
+		cnt += n;
+	}
+
+	return cnt;
+}
+
+/*
+* ring_out
+*
+* @desc:	copy the bytes held in a ring into a proc buffer, through the proc's address space
+*
+* @output:	n		number of bytes copied, limited by the bytes held in the ring
+*/
+static int ring_out(uart_ring_t *r, pcb_t *p, unsigned char *buf, int len)
+{
+	unsigned int n, start;
+	int cnt = 0;
+
+	while(cnt < len && ring_cnt(r))
+	{
+		start = r->tail & UART_RING_MASK;
+		n = ring_cnt(r);
+		if(n > UART_RING_SZ - start)
+			n = UART_RING_SZ - start;
+		if(n > len - cnt)
+			n = len - cnt;
+
+		vm_copy(p, buf + cnt, NULL, &r->buf[start], n);
+		r->tail += n;
+		cnt += n;
+	}
+
+	return cnt;
+}
+
+/*
+* uart_irqs
+*
+* @desc:	set the interrupts raised by the uart, the register is only written when they change
+*/
+static void uart_irqs(unsigned char ier)
+{
+	if(ier != uart_ier)
+	{
+		uart_ier = ier;
+		outb(UART_BASE + UART_IER, ier);
+	}
+}
+
+/*
+* uart_init
+*
+* @desc:	program COM1 for 8N1 with both fifos enabled, and register the serial device
+*
+* @note:	the uart raises no interrupt until the device is opened
+*/
+void uart_init()
+{
+	devsw_t d;
+
+	outb(UART_BASE + UART_IER, 0);
+	outb(UART_BASE + UART_LCR, LCR_DLAB);
+	outb(UART_BASE + UART_DATA, UART_DIVISOR & 0xff);
+	outb(UART_BASE + UART_IER, UART_DIVISOR >> 8);
+	outb(UART_BASE + UART_LCR, LCR_8N1);
+	outb(UART_BASE + UART_FCR, FCR_ENABLE | FCR_CLEAR | FCR_TRIGGER_14);
+	outb(UART_BASE + UART_MCR, MCR_DTR | MCR_RTS | MCR_OUT2);
+
+	memset(&d, 0, sizeof(devsw_t));
+	d.dvnum    	= SERIAL;
+	d.dvopen   	= uart_open;
+	d.dvclose  	= uart_close;
+	d.dvread   	= uart_read;
+	d.dvwrite  	= uart_write;
+	d.dvcancel   	= uart_cancel;
+	d.dvpoll   	= uart_poll;
+	d.dvcsr   	= (void *) UART_BASE;
+	d.dviint   	= uart_iint;
+	di_register(&d);
+}
+
+/*
+* uart_open
+*
+* @desc:	enables the receive interrupt and the uart irq
+*
+* @output:	rc		returns 0 on successful device open
+*/
+int uart_open(devsw_t* d, fd_t *f)
+{
+	/* drop anything received while the device was closed */
+	while(inb(UART_BASE + UART_LSR) & LSR_DR)
+		inb(UART_BASE + UART_DATA);
+	uart_rx.tail = uart_rx.head;
+
+	uart_irqs(IER_RDA | IER_RLS | (ring_cnt(&uart_tx) ? IER_THRE : 0));
+	enable_irq(UART_IRQ, 0);
+
+	return DEV_SUCCESS;
+}
+
+/*
+* uart_close
+*
+* @desc:	disables the receive interrupt, output already queued is still transmitted
+*
+* @output:	rc		returns 0 on successful device close
+*/
+int uart_close(devsw_t* d, fd_t *f)
+{
+	uart_irqs(uart_ier & IER_THRE);
+	if(!uart_ier)
+		enable_irq(UART_IRQ, 1);
+
+	return DEV_SUCCESS;
+}
+
+/*
+* uart_start
+*
+* @desc:	refill the transmit fifo from the transmit ring, and the ring from the blocked writers once it has room
+*
+* @note:	this is a lower layer function, the fifo only takes UART_FIFO bytes when it is empty, the
+*		transmit interrupt stays enabled for as long as there is output left. blocked writers are
+*		refilled in the order they were made and each is readied once all of its buffer is queued
+*/
+static void uart_start()
+{
+	uarti_t *k;
+	int n;
+
+	if(inb(UART_BASE + UART_LSR) & LSR_THRE)
+	{
+		for(n=0 ; n<UART_FIFO && ring_cnt(&uart_tx) ; n++)
+			outb(UART_BASE + UART_DATA, uart_tx.buf[uart_tx.tail++ & UART_RING_MASK]);
+	}
+
+	while((k = uart_wq))
+	{
+		k->bufi += ring_in(&uart_tx, k->p, (unsigned char *) k->buf + k->bufi, k->buflen - k->bufi);
+		if(k->bufi < k->buflen)
+			break;
+
+		uart_wq = k->next;
+		k->p->rc = k->bufi;
+		k->p->state = READY_STATE;
+		ready(k->p);
+		kfree(k);
+	}
+
+	uart_irqs(ring_cnt(&uart_tx) ? uart_ier | IER_THRE : uart_ier & ~IER_THRE);
+}
+
+/*
+* uart_write
+*
+* @desc:	queues a user buffer for transmission
+*
+* @param:	p		proc writing to the device
+*		d
+*		f
+*		buf		user buffer
+*		buflen		user buffer length
+*
+* @output:	rc		number of bytes queued, -1 when buf is not memory the proc may pass in or no kernel
+*				memory is left to queue the write, BLOCKERR when f is O_NONBLOCK and nothing could be
+*				queued
+*
+* @note:	this is an upper layer function, the proc blocks when the transmit ring cannot take all of buf and
+*		is readied by the transmit interrupt once the rest has been queued. writes blocked ahead of this
+*		one, from any proc holding the device open, are queued first so writes are never interleaved. an
+*		O_NONBLOCK write queues what fits behind them and never blocks
+*/
+int uart_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen)
+{
+	uarti_t *k, **q;
+	int n = 0;
+
+	if(!validate_range(p, buf, buflen))
+		return DEV_ERR;
+
+	if(!uart_wq)
+		n = ring_in(&uart_tx, p, buf, buflen);
+
+	if(n < buflen && !(f->flags & O_NONBLOCK))
+	{
+		if((k = (uarti_t *) kmalloc(sizeof(uarti_t))))
+		{
+			k->p = p;
+			k->f = f;
+			k->buf = buf;
+			k->buflen = buflen;
+			k->bufi = n;
+			k->next = NULL;
+
+			for(q = &uart_wq ; *q ; q = &((*q)->next));
+			*q = k;
+
+			/* the transmit ring may take the rest right away, which readies the proc */
+			p->state = BLOCK_ON_DEV_STATE;
+		}
+		else if(!n)
+			n = DEV_ERR;
+	}
+
+	uart_start();
+
+	if(f->flags & O_NONBLOCK)
+		return n || !buflen ? n : BLOCKERR;
+
+	return n;
+}
+
+/*
+* uart_notify
+*
+* @desc:	hands the received bytes to the queued reader
+*
+* @note:	this is an upper layer function, a read completes with whatever has arrived, at least one byte
+*/
+static void uart_notify()
+{
+	pcb_t *p = uart_reader;
+
+	if(!p || !ring_cnt(&uart_rx))
+		return;
+
+	uart_reader = NULL;
+	di_complete(p, uart_rio.f, ring_out(&uart_rx, p, uart_rio.buf, uart_rio.buflen));
+}
+
+/*
+* uart_read
+*
+* @desc:	takes the received bytes, blocking the proc until at least one byte has arrived
+*
+* @param:	p		proc reading from the device
+*		d
+*		f
+*		buf		user buffer
+*		buflen		user buffer length
+*
+* @output:	rc		returns 0 on success, -1 when buf is not memory the proc may pass in or another read is
+*				queued, BLOCKERR when f is O_NONBLOCK and no byte has arrived
+*
+* @note:	this is an upper layer function, the read is completed before returning when bytes are already waiting
+*/
+int uart_read(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen)
+{
+	if(buflen <= 0 || !validate_range(p, buf, buflen) || uart_reader)
+		return DEV_ERR;
+
+	if(f->flags & O_NONBLOCK && !ring_cnt(&uart_rx))
+		return BLOCKERR;
+
+	uart_rio.f = f;
+	uart_rio.buf = buf;
+	uart_rio.buflen = buflen;
+	uart_rio.bufi = 0;
+	uart_reader = p;
+
+	uart_notify();
+
+	return DEV_SUCCESS;
+}
+
+/*
+* uart_iint
+*
+* @desc:	handles serial device interrupts until the uart has none pending
+*
+* @note:	this is a lower layer function, the receive fifo is drained into the ring and bytes are only dropped
+*		when UART_RING_SZ of them are waiting for a reader
+*/
+int uart_iint()
+{
+	unsigned char iir;
+
+	while(!((iir = inb(UART_BASE + UART_IIR)) & IIR_NONE))
+	{
+		switch(iir & IIR_ID)
+		{
+			case IIR_RDA:
+			case IIR_TIMEOUT:
+				while(inb(UART_BASE + UART_LSR) & LSR_DR)
+				{
+					if(ring_cnt(&uart_rx) < UART_RING_SZ)
+						uart_rx.buf[uart_rx.head++ & UART_RING_MASK] = inb(UART_BASE + UART_DATA);
+					else
+					{
+						inb(UART_BASE + UART_DATA);
+						uart_lost++;
+					}
+				}
+				uart_notify();
+				di_wake(&(dev_table[SERIAL]));
+				break;
+
+			case IIR_THRE:
+				uart_start();
+				di_wake(&(dev_table[SERIAL]));
+				break;
+
+			case IIR_RLS:
+				inb(UART_BASE + UART_LSR);
+				break;
+
+			case IIR_MSR:
+				inb(UART_BASE + UART_MSR);
+				break;
+		}
+	}
+
+	return DEV_SUCCESS;
+}
+
+/*
+* uart_cancel
+*
+* @desc:	withdraws the queued read or write of proc
+*
+* @param:	d
+*		p		proc whose read or write is withdrawn
+*		f		fd whose read or write is withdrawn, NULL for the one proc is blocked on, which readies proc
+*
+* @note:	this is an upper layer function, bytes of an abandoned write that were already queued are still sent
+*		and the writes blocked behind it move up
+*/
+int uart_cancel(devsw_t* d, pcb_t *p, fd_t *f)
+{
+	uarti_t *k, **q;
+
+	for(q = &uart_wq ; (k = *q) && (k->p != p || (f && k->f != f)) ; q = &(k->next));
+
+	if(p == uart_reader && (f ? uart_rio.f == f : !(uart_rio.f->flags & O_ASYNC)))
+		uart_reader = NULL;
+	else if(k)
+	{
+		*q = k->next;
+		kfree(k);
+		uart_start();
+	}
+	else
+		return DEV_ERR;
+
+	if(!f)
+	{
+		p->state = READY_STATE;
+		ready(p);
+	}
+	return DEV_SUCCESS;
+}
+
+/*
+* uart_poll
+*
+* @desc:	the uart is ready for reading once a byte has arrived, and for writing while the transmit ring has room
+*
+* @output:	revents		POLLIN and/or POLLOUT
+*/
+int uart_poll(devsw_t* d, fd_t *f, unsigned int events)
+{
+	unsigned int revents = 0;
+
+	if(!uart_reader && ring_cnt(&uart_rx))
+		revents |= POLLIN;
+	if(!uart_wq && ring_cnt(&uart_tx) < UART_RING_SZ)
+		revents |= POLLOUT;
+
+	return revents;
+}
+
+/*
+* puts_uart
+*
+* @desc:	outputs the bytes queued each way and the bytes lost on receive
+*/
+void puts_uart()
+{
+	kprintf("uart: %d to send, %d received, %d lost\n", ring_cnt(&uart_tx), ring_cnt(&uart_rx), uart_lost);
+}
@@ -22,16 +22,50 @@
 
 #include <xeroskernel.h>
 
-unsigned char console[80];
+
+#ifdef POLL_TEST
+#define POLLTEST_SIG	20		/* signal the poll tests interrupt a poll with 	*/
+#define POLLTEST_MSG	415		/* message the poll tests send 			*/
+
+static unsigned int polltest_pid;	/* pid of polltest_root 			*/
+#endif
+
+#ifdef PIPE_TEST
+#include <pipe.h>
+
+#define PIPETEST_SIG	21			/* signal the pipe tests cancel a read with 	*/
+#define PIPETEST_LEN	(PIPE_RING_SZ + 512)	/* write that does not fit in the pipe ring 	*/
+#endif
+
+#ifdef KBD_TEST
+#include <kbd.h>
+
+#define KBDTEST_WAIT	5000		/* ms given to type ahead of the first read 	*/
+#define KBDTEST_LEN	32
+#endif
+
+#ifdef ASYNC_TEST
+#define ASYNCTEST_SIG	22		/* signal raised when an O_ASYNC read completes */
+
+static int asynctest_sigs;		/* completion signals taken 			*/
+#endif
+
+#ifdef RAMDISK_TEST
+#define RAMTEST_OFF	(BLK_SZ - 12)		/* write that straddles the first block boundary */
+#define RAMTEST_LEN	24
+#endif
 
 /*
 * idleproc
 *
 * @desc:	executes the idle process
+*
+* @note:	the cpu is halted until the next interrupt, interrupts are enabled in the proc eflags
 */
 void idleproc ()
 {
-	for(;;);
+	for(;;)
+		__asm __volatile("hlt");
 }
 
 
@@ -42,11 +76,626 @@ void idleproc ()
 */
 void root()
 {	
+	char console[80];	/* on the stack, sysputs() only takes proc memory */
+
 	sprintf(console, "Welcome to bkernel!");
 	sysputs(console);
 
+#ifdef POLL_TEST
+	syscreate(&polltest_root, PROC_STACK);
+#endif
+#ifdef PIPE_TEST
+	syscreate(&pipetest_root, PROC_STACK);
+#endif
+#ifdef RAMDISK_TEST
+	syscreate(&ramtest_root, PROC_STACK);
+#endif
+#ifdef KBD_TEST
+	syscreate(&kbdtest_root, PROC_STACK);
+#endif
+#ifdef FD_TEST
+	syscreate(&fdtest_root, PROC_STACK);
+#endif
+#ifdef ASYNC_TEST
+	syscreate(&asynctest_root, PROC_STACK);
+#endif
 
 	sprintf(console, "Goodbye!");
 	sysputs(console);
 }
 
+
+#ifdef POLL_TEST
+/*
+* polltest_handler
+*
+* @desc:	handler of the signal that interrupts a poll, the poll returns once it is done
+*/
+static void polltest_handler(void *cntx)
+{
+}
+
+/*
+* polltest_sender
+*
+* @desc:	blocks sending to polltest_root, which is polling for a blocked sender
+*/
+static void polltest_sender(void)
+{
+	int msg = POLLTEST_MSG;
+
+	syssend(polltest_pid, &msg, sizeof(int));
+}
+
+/*
+* polltest_killer
+*
+* @desc:	signals polltest_root once it has had the time to block in a poll
+*/
+static void polltest_killer(void)
+{
+	syssleep(100);
+	syskill(polltest_pid, POLLTEST_SIG);
+}
+
+/*
+* polltest_root
+*
+* @desc:	executes the syspoll test cases
+*/
+void polltest_root(void)
+{
+	pollfd_t set[1];
+	unsigned int pid;
+	int rc, msg;
+	void (*old_handler)(void *);
+
+	polltest_pid = sysgetpid();
+
+	/*
+	* poll test case 1:
+	* a poll with nothing ready returns 0 once its timeout is up
+	*/
+	kprintf("Begin Poll Test Case 1 ... \n");
+	set[0].kind = POLL_MSG;
+	set[0].id = 0;
+	set[0].events = POLLIN;
+	rc = syspoll(set, 1, 50);
+	if(rc == 0 && set[0].revents == 0)
+		kprintf("PTC1 Pass: poll timed out with no entry ready\n");
+	else
+		kprintf("PTC1 Fail: poll returned %d on timeout\n", rc);
+
+	/*
+	* poll test case 2:
+	* a proc blocking to send to the poller wakes a POLL_MSG poll, the message is then taken without blocking
+	*/
+	kprintf("Begin Poll Test Case 2 ... \n");
+	syscreate(&polltest_sender, PROC_STACK);
+	rc = syspoll(set, 1, -1);
+	pid = 0;
+	if(rc == 1 && set[0].revents == POLLIN && sysrecv(&pid, &msg, sizeof(int)) == sizeof(int) && msg == POLLTEST_MSG)
+		kprintf("PTC2 Pass: blocked sender %d woke the poll\n", pid);
+	else
+		kprintf("PTC2 Fail: poll returned %d with revents %d\n", rc, set[0].revents);
+
+	/*
+	* poll test case 3:
+	* a signal no entry waits for interrupts the poll
+	*/
+	kprintf("Begin Poll Test Case 3 ... \n");
+	syssighandler(POLLTEST_SIG, &polltest_handler, &old_handler);
+	syscreate(&polltest_killer, PROC_STACK);
+	rc = syspoll(set, 1, -1);
+	if(rc == ERR_SIGNAL_UNBLOCK_SYSCALL)
+		kprintf("PTC3 Pass: signal interrupted the poll\n");
+	else
+		kprintf("PTC3 Fail: poll returned %d after the signal\n", rc);
+
+	/*
+	* poll test case 4:
+	* an fd that is not open reports POLLERR right away, even with no timeout
+	*/
+	kprintf("Begin Poll Test Case 4 ... \n");
+	set[0].kind = POLL_FD;
+	set[0].id = FD_SZ;
+	set[0].events = POLLIN;
+	rc = syspoll(set, 1, -1);
+	if(rc == 1 && set[0].revents == POLLERR)
+		kprintf("PTC4 Pass: bad fd reported POLLERR\n");
+	else
+		kprintf("PTC4 Fail: poll returned %d with revents %d\n", rc, set[0].revents);
+}
+#endif
+
+#ifdef PIPE_TEST
+/*
+* pipetest_handler
+*
+* @desc:	handler of the signal that cancels a blocked read, the read returns once it is done
+*/
+static void pipetest_handler(void *cntx)
+{
+}
+
+/*
+* pipetest_root
+*
+* @desc:	executes the syspipe test cases, each writer, reader or signaller is a forked clone holding both ends
+*/
+void pipetest_root(void)
+{
+	int fds[2];
+	char msg[5] = "pipe";
+	char buf[16];
+	char *big;
+	unsigned int ppid, pid;
+	int rc, cnt, n;
+	void (*old_handler)(void *);
+
+	ppid = sysgetpid();
+	if(syspipe(fds) != SYSOK)
+	{
+		kprintf("PPTC Fail: pipe could not be created\n");
+		return;
+	}
+
+	/*
+	* pipe test case 1:
+	* a read of an empty pipe blocks until a writer fills it
+	*/
+	kprintf("Begin Pipe Test Case 1 ... \n");
+	if(!sysfork())
+	{
+		syssleep(100);
+		syswrite(fds[1], msg, sizeof(msg));
+		sysstop();
+	}
+
+	rc = sysread(fds[0], buf, sizeof(buf));
+	for(n = 0 ; n < rc && n < sizeof(msg) && buf[n] == msg[n] ; n++);
+	if(rc == sizeof(msg) && n == sizeof(msg))
+		kprintf("PPTC1 Pass: blocked read got %s\n", buf);
+	else
+		kprintf("PPTC1 Fail: read returned %d\n", rc);
+
+	/*
+	* pipe test case 2:
+	* a write larger than the ring blocks until a reader has drained it
+	*/
+	kprintf("Begin Pipe Test Case 2 ... \n");
+	big = (char *) sysmalloc(PIPETEST_LEN);
+	if(!big)
+		kprintf("PPTC2 Fail: no heap for the write\n");
+	else
+	{
+		for(n = 0 ; n < PIPETEST_LEN ; n++)
+			big[n] = 'p';
+		if(!sysfork())
+		{
+			syssleep(100);
+			for(cnt = 0 ; cnt < PIPETEST_LEN && (n = sysread(fds[0], big, PIPETEST_LEN)) > 0 ; cnt += n);
+			syssend(ppid, &cnt, sizeof(int));
+			sysstop();
+		}
+
+		rc = syswrite(fds[1], big, PIPETEST_LEN);
+		pid = 0;
+		cnt = 0;
+		sysrecv(&pid, &cnt, sizeof(int));
+		if(rc == PIPETEST_LEN && cnt == PIPETEST_LEN)
+			kprintf("PPTC2 Pass: blocked write of %d bytes drained by %d\n", rc, pid);
+		else
+			kprintf("PPTC2 Fail: write returned %d, reader got %d\n", rc, cnt);
+	}
+
+	/*
+	* pipe test case 3:
+	* a signal cancels a blocked read
+	*/
+	kprintf("Begin Pipe Test Case 3 ... \n");
+	syssighandler(PIPETEST_SIG, &pipetest_handler, &old_handler);
+	if(!sysfork())
+	{
+		syssleep(100);
+		syskill(ppid, PIPETEST_SIG);
+		sysstop();
+	}
+
+	rc = sysread(fds[0], buf, sizeof(buf));
+	if(rc == ERR_SIGNAL_UNBLOCK_SYSCALL)
+		kprintf("PPTC3 Pass: signal cancelled the blocked read\n");
+	else
+		kprintf("PPTC3 Fail: read returned %d after the signal\n", rc);
+
+	/*
+	* pipe test case 4:
+	* a read returns 0 once the pipe is drained and the last writer has closed its end
+	*/
+	kprintf("Begin Pipe Test Case 4 ... \n");
+	if(!sysfork())
+	{
+		syssleep(100);
+		syswrite(fds[1], buf, 1);
+		sysstop();
+	}
+
+	sysclose(fds[1]);
+	rc = sysread(fds[0], buf, sizeof(buf));
+	n = sysread(fds[0], buf, sizeof(buf));
+	if(rc == 1 && n == 0)
+		kprintf("PPTC4 Pass: read hit eof after the last writer closed\n");
+	else
+		kprintf("PPTC4 Fail: reads returned %d then %d\n", rc, n);
+
+	sysclose(fds[0]);
+}
+#endif
+
+
+#ifdef RAMDISK_TEST
+/*
+* ramtest_root
+*
+* @desc:	executes the ramdisk test cases, the disk is written over so it should not hold an image worth keeping
+*/
+void ramtest_root(void)
+{
+	char msg[RAMTEST_LEN];
+	char buf[RAMTEST_LEN];
+	unsigned char *blk;
+	unsigned int hits, misses, before;
+	int fd, size, rc, n, i;
+
+	fd = sysopen(RAMDISK);
+	if(fd < 0)
+	{
+		kprintf("RTC Fail: ramdisk could not be opened\n");
+		return;
+	}
+	size = sysioctl(fd, BLK_SIZE);
+
+	/*
+	* ramdisk test case 1:
+	* a write across a block boundary reads back the same bytes
+	*/
+	kprintf("Begin Ramdisk Test Case 1 ... \n");
+	for(n = 0 ; n < RAMTEST_LEN ; n++)
+	{
+		msg[n] = 'a' + n;
+		buf[n] = 0;
+	}
+	sysioctl(fd, BLK_SEEK, RAMTEST_OFF);
+	rc = syswrite(fd, msg, RAMTEST_LEN);
+	sysioctl(fd, BLK_SEEK, RAMTEST_OFF);
+	n = sysread(fd, buf, RAMTEST_LEN);
+	for(i = 0 ; i < RAMTEST_LEN && buf[i] == msg[i] ; i++);
+	if(rc == RAMTEST_LEN && n == RAMTEST_LEN && i == RAMTEST_LEN)
+		kprintf("RTC1 Pass: %d bytes at offset %d read back\n", n, RAMTEST_OFF);
+	else
+		kprintf("RTC1 Fail: write returned %d, read returned %d, %d bytes matched\n", rc, n, i);
+
+	/*
+	* ramdisk test case 2:
+	* the disk is a whole number of blocks, a seek may reach its end but not go past it or below 0
+	*/
+	kprintf("Begin Ramdisk Test Case 2 ... \n");
+	if(size > 0 && !(size % BLK_SZ) && sysioctl(fd, BLK_SEEK, size) == 0 && sysioctl(fd, BLK_SEEK, size + 1) == -1 &&
+		sysioctl(fd, BLK_SEEK, -1) == -1)
+		kprintf("RTC2 Pass: seeks limited to the %d byte disk\n", size);
+	else
+		kprintf("RTC2 Fail: disk size %d or seek limits wrong\n", size);
+
+	/*
+	* ramdisk test case 3:
+	* a read running past the end of the disk is cut short, and a read at the end returns 0
+	*/
+	kprintf("Begin Ramdisk Test Case 3 ... \n");
+	sysioctl(fd, BLK_SEEK, size - RAMTEST_LEN / 2);
+	rc = sysread(fd, buf, RAMTEST_LEN);
+	n = sysread(fd, buf, RAMTEST_LEN);
+	if(rc == RAMTEST_LEN / 2 && n == 0)
+		kprintf("RTC3 Pass: short read of %d bytes then eof\n", rc);
+	else
+		kprintf("RTC3 Fail: reads returned %d then %d\n", rc, n);
+
+	/*
+	* ramdisk test case 4:
+	* writing more blocks than the cache holds evicts the first dirty block, which reads back from the disk
+	*/
+	kprintf("Begin Ramdisk Test Case 4 ... \n");
+	blk = (unsigned char *) sysmalloc(BLK_SZ);
+	if(!blk || size < (BCACHE_SZ + 1) * BLK_SZ)
+		kprintf("RTC4 Fail: no heap for a block or the disk is smaller than the cache\n");
+	else
+	{
+		for(i = 0 ; i <= BCACHE_SZ ; i++)
+		{
+			for(n = 0 ; n < BLK_SZ ; n++)
+				blk[n] = i;
+			sysioctl(fd, BLK_SEEK, i * BLK_SZ);
+			syswrite(fd, blk, BLK_SZ);
+		}
+
+		for(n = 0 ; n < BLK_SZ ; n++)
+			blk[n] = 0xff;
+		bcache_stats(&hits, &before);
+		sysioctl(fd, BLK_SEEK, 0);
+		rc = sysread(fd, blk, BLK_SZ);
+		bcache_stats(&hits, &misses);
+		for(n = 0 ; n < BLK_SZ && !blk[n] ; n++);
+		if(rc == BLK_SZ && n == BLK_SZ && misses > before)
+			kprintf("RTC4 Pass: evicted block 0 was written back\n");
+		else
+			kprintf("RTC4 Fail: read returned %d, %d bytes matched, %d misses\n", rc, n, misses - before);
+	}
+
+	sysclose(fd);
+}
+#endif
+
+
+#ifdef KBD_TEST
+/*
+* kbdtest_root
+*
+* @desc:	executes the keyboard type-ahead test cases, two lines must be typed while the test sleeps
+*/
+void kbdtest_root(void)
+{
+	char buf[KBDTEST_LEN];
+	unsigned int ppid, pid;
+	int fd, rc, eol;
+
+	ppid = sysgetpid();
+	fd = sysopen(KBD_NECHO);
+	if(fd < 0)
+	{
+		kprintf("KTC Fail: keyboard could not be opened\n");
+		return;
+	}
+
+	kprintf("Type two lines, each ended with enter, within %d ms ...\n", KBDTEST_WAIT);
+	syssleep(KBDTEST_WAIT);
+
+	/*
+	* keyboard test case 1:
+	* a reader forked after the keys were typed takes the first line only
+	*/
+	kprintf("Begin Keyboard Test Case 1 ... \n");
+	if(!sysfork())
+	{
+		rc = sysread(fd, buf, KBDTEST_LEN);
+		eol = rc > 0 && buf[rc - 1] == ENTER_KEY;
+		syssend(ppid, &eol, sizeof(int));
+		sysstop();
+	}
+
+	pid = 0;
+	eol = 0;
+	sysrecv(&pid, &eol, sizeof(int));
+	if(eol)
+		kprintf("KTC1 Pass: reader %d took the first typed-ahead line\n", pid);
+	else
+		kprintf("KTC1 Fail: reader %d did not get a whole line\n", pid);
+
+	/*
+	* keyboard test case 2:
+	* the second line is still waiting for the next reader, which takes it without blocking
+	*/
+	kprintf("Begin Keyboard Test Case 2 ... \n");
+	sysioctl(fd, SET_FLAGS, O_NONBLOCK);
+	rc = sysread(fd, buf, KBDTEST_LEN);
+	if(rc > 0 && buf[rc - 1] == ENTER_KEY)
+		kprintf("KTC2 Pass: second line of %d keys was kept for the next reader\n", rc);
+	else
+		kprintf("KTC2 Fail: non-blocking read returned %d\n", rc);
+
+	/*
+	* keyboard test case 3:
+	* once both lines are taken a non-blocking read finds nothing waiting
+	*/
+	kprintf("Begin Keyboard Test Case 3 ... \n");
+	rc = sysread(fd, buf, KBDTEST_LEN);
+	if(rc == BLOCKERR)
+		kprintf("KTC3 Pass: no keys left after both lines\n");
+	else
+		kprintf("KTC3 Fail: non-blocking read returned %d\n", rc);
+
+	sysclose(fd);
+}
+#endif
+
+
+#ifdef FD_TEST
+/*
+* fdtest_root
+*
+* @desc:	executes the test cases of a device open through many fds, and of pipe ends shared with forked clones
+*/
+void fdtest_root(void)
+{
+	int fds[FD_SZ];
+	char msg[4] = "fd\n";
+	char buf[4];
+	int rc, n, i;
+
+	/*
+	* fd test case 1:
+	* the console opens once per fd until the fd table is full
+	*/
+	kprintf("Begin Fd Test Case 1 ... \n");
+	for(i = 0 ; i < FD_SZ && (fds[i] = sysopen(CONSOLE)) >= 0 ; i++);
+	for(n = 0 ; n < i && syswrite(fds[n], msg, 3) == 3 ; n++);
+	rc = sysopen(CONSOLE);
+	if(i == FD_SZ && n == FD_SZ && rc == -1)
+		kprintf("FTC1 Pass: console written through %d fds\n", n);
+	else
+		kprintf("FTC1 Fail: %d opens, %d writes, last open returned %d\n", i, n, rc);
+
+	/*
+	* fd test case 2:
+	* flags belong to the fd, not to the device
+	*/
+	kprintf("Begin Fd Test Case 2 ... \n");
+	sysioctl(fds[0], SET_FLAGS, O_NONBLOCK);
+	if(sysioctl(fds[0], GET_FLAGS) == O_NONBLOCK && sysioctl(fds[1], GET_FLAGS) == 0)
+		kprintf("FTC2 Pass: flags set on one fd only\n");
+	else
+		kprintf("FTC2 Fail: flags shared between fds\n");
+
+	/*
+	* fd test case 3:
+	* closing one fd leaves the device open through the others
+	*/
+	kprintf("Begin Fd Test Case 3 ... \n");
+	sysclose(fds[0]);
+	rc = syswrite(fds[0], msg, 3);
+	n = syswrite(fds[1], msg, 3);
+	if(rc == -1 && n == 3)
+		kprintf("FTC3 Pass: closed fd refused, open fd still writes\n");
+	else
+		kprintf("FTC3 Fail: writes returned %d and %d\n", rc, n);
+	for(i = 1 ; i < FD_SZ ; i++)
+		sysclose(fds[i]);
+
+	/*
+	* fd test case 4:
+	* a pipe reaches eof only once the write end a forked clone holds is closed too
+	*/
+	kprintf("Begin Fd Test Case 4 ... \n");
+	if(syspipe(fds) != SYSOK)
+		kprintf("FTC4 Fail: pipe could not be created\n");
+	else
+	{
+		if(!sysfork())
+		{
+			syssleep(100);
+			syswrite(fds[1], msg, 1);
+			sysstop();
+		}
+
+		sysclose(fds[1]);
+		rc = sysread(fds[0], buf, sizeof(buf));
+		n = sysread(fds[0], buf, sizeof(buf));
+		if(rc == 1 && n == 0)
+			kprintf("FTC4 Pass: eof after the clone's write end was released\n");
+		else
+			kprintf("FTC4 Fail: reads returned %d then %d\n", rc, n);
+		sysclose(fds[0]);
+	}
+
+	/*
+	* fd test case 5:
+	* a pipe takes writes while a forked clone holds the read end, and refuses them once it has stopped
+	*/
+	kprintf("Begin Fd Test Case 5 ... \n");
+	if(syspipe(fds) != SYSOK)
+		kprintf("FTC5 Fail: pipe could not be created\n");
+	else
+	{
+		if(!sysfork())
+		{
+			syssleep(100);
+			sysstop();
+		}
+
+		sysclose(fds[0]);
+		rc = syswrite(fds[1], msg, 1);
+		syssleep(200);
+		n = syswrite(fds[1], msg, 1);
+		if(rc == 1 && n == -1)
+			kprintf("FTC5 Pass: write refused once no fd held the read end\n");
+		else
+			kprintf("FTC5 Fail: writes returned %d then %d\n", rc, n);
+		sysclose(fds[1]);
+	}
+}
+#endif
+
+
+#ifdef ASYNC_TEST
+/*
+* asynctest_handler
+*
+* @desc:	handler of the signal raised when an O_ASYNC read completes
+*/
+static void asynctest_handler(void *cntx)
+{
+	asynctest_sigs++;
+}
+
+/*
+* asynctest_root
+*
+* @desc:	executes the O_NONBLOCK and O_ASYNC read test cases on a pipe, the writer is a forked clone
+*/
+void asynctest_root(void)
+{
+	int fds[2];
+	char msg[6] = "async";
+	char buf[16];
+	int rc, n, i;
+	void (*old_handler)(void *);
+
+	if(syspipe(fds) != SYSOK)
+	{
+		kprintf("ATC Fail: pipe could not be created\n");
+		return;
+	}
+
+	/*
+	* async test case 1:
+	* an O_NONBLOCK read of an empty pipe fails with BLOCKERR instead of blocking
+	*/
+	kprintf("Begin Async Test Case 1 ... \n");
+	sysioctl(fds[0], SET_FLAGS, O_NONBLOCK);
+	rc = sysread(fds[0], buf, sizeof(buf));
+	if(rc == BLOCKERR)
+		kprintf("ATC1 Pass: non-blocking read of an empty pipe returned BLOCKERR\n");
+	else
+		kprintf("ATC1 Fail: non-blocking read returned %d\n", rc);
+
+	/*
+	* async test case 2:
+	* an O_ASYNC read returns at once and stays pending, the flags are locked and a second read is refused
+	*/
+	kprintf("Begin Async Test Case 2 ... \n");
+	asynctest_sigs = 0;
+	syssighandler(ASYNCTEST_SIG, &asynctest_handler, &old_handler);
+	sysioctl(fds[0], SET_FLAGS, O_ASYNC);
+	sysioctl(fds[0], SET_ASYNC_SIG, ASYNCTEST_SIG);
+	for(n = 0 ; n < sizeof(buf) ; n++)
+		buf[n] = 0;
+	rc = sysread(fds[0], buf, sizeof(buf));
+	if(rc == 0 && sysioctl(fds[0], GET_ASYNC) == BLOCKERR && sysioctl(fds[0], SET_FLAGS, 0) == -1 &&
+		sysread(fds[0], buf, sizeof(buf)) == -1)
+		kprintf("ATC2 Pass: async read is pending\n");
+	else
+		kprintf("ATC2 Fail: async read returned %d\n", rc);
+
+	/*
+	* async test case 3:
+	* a write completes the pending read, which raises the signal and leaves the count for GET_ASYNC
+	*/
+	kprintf("Begin Async Test Case 3 ... \n");
+	if(!sysfork())
+	{
+		syssleep(100);
+		syswrite(fds[1], msg, sizeof(msg));
+		sysstop();
+	}
+
+	for(i = 0 ; i < 10 && !asynctest_sigs ; i++)
+		syssleep(100);
+	rc = sysioctl(fds[0], GET_ASYNC);
+	for(n = 0 ; n < sizeof(msg) && buf[n] == msg[n] ; n++);
+	if(asynctest_sigs == 1 && rc == sizeof(msg) && n == sizeof(msg))
+		kprintf("ATC3 Pass: async read of %s completed with a signal\n", buf);
+	else
+		kprintf("ATC3 Fail: %d signals, GET_ASYNC returned %d\n", asynctest_sigs, rc);
+
+	sysclose(fds[0]);
+	sysclose(fds[1]);
+}
+#endif
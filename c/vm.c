@@ -0,0 +1,1056 @@
+/* Virtual Memory Manager
+ *
+ * This is the paging unit, every process runs in its own page directory where
+ * the kernel image, heap and devices are identity mapped through page tables
+ * shared by all processes, and the process stack is reserved at a private
+ * virtual address and committed one page at a time on page faults.
+ *
+ * Copyright (c) 2013 Jack Wu <jack.wu@live.ca>
+ *
+ * This file is part of bkernel.
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <xeroskernel.h>
+#include <xeroslib.h>
+#include <i386.h>
+
+#define PF_STACK	1024		/* page fault task stack size in words */
+
+extern struct sd gdt[];
+extern struct idt idt[];
+
+void _pf_entry_point(void);		/* page fault task entry 		*/
+
+static unsigned int *kernel_pd;		/* identity mapped kernel space, its page tables are shared by every proc 	*/
+static pcb_t *vm_current = NULL;	/* proc whose page directory is loaded 						*/
+
+static void vm_cut(pcb_t *p, unsigned int addr);
+
+static unsigned int *stack_cache[BUDDY_ORDERS][STACK_CACHE_DEPTH];	/* page directories of stopped proc, by stack order 	*/
+static int stack_cache_cnt[BUDDY_ORDERS];
+static unsigned int stack_cache_hits = 0;
+static unsigned int stack_cache_misses = 0;
+
+/* number of other address spaces sharing each page pool frame copy-on-write, see vm_fork(). a frame can be
+ * shared by every proc and every cached address space, which is more than a byte counts with PROC_SZ raised */
+static unsigned short frame_refs[PAGE_POOL_SZ / NBPG];
+#define frame_index(f)	(((unsigned int)(f) - page_pool_base) / NBPG)
+
+static struct tss main_tss;		/* kernel task, state is saved here while a page fault is serviced 		*/
+static struct tss pf_tss;		/* page fault task 								*/
+static unsigned int pf_stack[PF_STACK];
+
+/* virtual address lies inside the reserved stack of proc */
+#define vm_stack(p,va)	((unsigned int)(va) >= (p)->stack_base && (unsigned int)(va) < VM_STACK_TOP)
+
+/* virtual address lies inside the heap arena of proc */
+#define vm_heap(p,va)	((unsigned int)(va) >= VM_HEAP_BASE && (unsigned int)(va) < (p)->heap_brk)
+
+/* strings are copied from proc in chunks of a heap paragraph, see copy_str_from_user() */
+#define STR_CHUNK	0x10
+
+/* virtual address is backed on demand for proc */
+#define vm_demand(p,va)	(vm_stack(p,va) || vm_heap(p,va))
+
+
+/*
+* set_cr3
+*
+* @desc:	load page directory, this also flushes the tlb
+*/
+static void set_cr3(unsigned int *pd)
+{
+	__asm __volatile("movl %0, %%cr3" : : "r" (pd) : "memory");
+}
+
+/*
+* get_cr2
+*
+* @desc:	get the faulting linear address of the last page fault
+*/
+static unsigned int get_cr2(void)
+{
+	unsigned int va;
+
+	__asm __volatile("movl %%cr2, %0" : "=r" (va));
+	return va;
+}
+
+/*
+* set_tss
+*
+* @desc:	install a 32-bit available tss descriptor in the gdt
+*
+* @param:	i		gdt entry
+*		ts		task state segment
+*/
+static void set_tss(int i, struct tss *ts)
+{
+	struct sd *psd = &gdt[i];
+	unsigned int base = (unsigned int) ts;
+	unsigned int limit = sizeof(struct tss) - 1;
+
+	psd->sd_lolimit = limit;
+	psd->sd_hilimit = limit >> 16;
+	psd->sd_lobase = base;
+	psd->sd_midbase = base >> 16;
+	psd->sd_hibase = base >> 24;
+	psd->sd_type = SDT_TSS & 0x7;
+	psd->sd_iscode = SDT_TSS >> 3;
+	psd->sd_isapp = 0;
+	psd->sd_dpl = 0;
+	psd->sd_present = 1;
+	psd->sd_avl = 0;
+	psd->sd_mbz = 0;
+	psd->sd_32b = 0;
+	psd->sd_gran = 0;
+}
+
+/*
+* frame_alloc
+*
+* @desc:	get a single page from the page allocator
+*
+* @output:	frame		zeroed page frame, NULL when the page pool is exhausted
+*/
+void *frame_alloc(void)
+{
+	unsigned int *frame = page_alloc(0);
+
+	/* cached address spaces are the first to go when the pool runs dry */
+	if(!frame && stack_cache_drain())
+		frame = page_alloc(0);
+
+	if(!frame) return NULL;
+
+	memset(frame, 0, NBPG);
+	return frame;
+}
+
+/*
+* frame_free
+*
+* @desc:	return a page frame to the page allocator, a frame still shared copy-on-write only drops a reference
+*/
+void frame_free(void *frame)
+{
+	if(is_page(frame) && frame_refs[frame_index(frame)])
+	{
+		frame_refs[frame_index(frame)]--;
+		return;
+	}
+
+	page_free(frame);
+}
+
+/*
+* vm_unshare
+*
+* @desc:	make a copy-on-write page writable, it is copied into a new frame while other address spaces still share it
+*
+* @param:	pte		page table entry of the page
+*
+* @output:	frame		private page frame backing the page, NULL when the page pool is exhausted
+*/
+static unsigned int *vm_unshare(unsigned int *pte)
+{
+	unsigned int *old = (unsigned int *) (*pte & PG_FRAME), *frame;
+
+	if(is_page(old) && frame_refs[frame_index(old)])
+	{
+		frame = frame_alloc();
+		if(!frame) return NULL;
+
+		blkcopy(frame, old, NBPG);
+		frame_refs[frame_index(old)]--;
+		*pte = (unsigned int) frame | PG_P | PG_RW;
+	}
+	else
+		*pte |= PG_RW;
+
+	return (unsigned int *) (*pte & PG_FRAME);
+}
+
+/*
+* vm_init
+*
+* @desc:	build the kernel page directory, turn on paging and install the page fault task
+*
+* @note:	a proc stack can only grow through a page fault, and since every proc runs in ring 0 the
+*		processor would push the fault frame onto the very stack that is missing. Hence #PF is
+*		routed through a task gate, which switches to pf_tss and its own stack before anything
+*		is pushed
+*/
+void vm_init(void)
+{
+	unsigned int addr, *pt;
+	struct idt *pidt;
+	int i;
+
+	/* identity map all physical memory, including the gaps between usable regions where devices live */
+	kernel_pd = frame_alloc();
+	for(addr = 0 ; kernel_pd && addr <= (unsigned int) maxaddr ; addr += NBPG)
+	{
+		if(!(kernel_pd[PDX(addr)] & PG_P))
+		{
+			if(!(pt = frame_alloc()))
+				break;
+			kernel_pd[PDX(addr)] = (unsigned int) pt | PG_P | PG_RW;
+		}
+
+		pt = (unsigned int *) (kernel_pd[PDX(addr)] & PG_FRAME);
+		pt[PTX(addr)] = addr | PG_P | PG_RW;
+	}
+
+	/* the kernel runs out of the identity map, paging can not be turned on without all of it */
+	if(!kernel_pd || addr <= (unsigned int) maxaddr)
+	{
+		klog(KLOG_ERR, "vm: page pool too small to map memory up to %x\n", maxaddr);
+		klog(KLOG_ERR, "\nHalting.....\n");
+		klog_flush();
+		for(;;);
+	}
+
+	/* kernel task, saves the interrupted state on a page fault */
+	memset(&main_tss, 0, sizeof(struct tss));
+	main_tss.ts_cr3 = (unsigned int) kernel_pd;
+	main_tss.ts_iomap = sizeof(struct tss);
+	set_tss(KTSS, &main_tss);
+
+	/* page fault task, always entered at _pf_entry_point with interrupts off */
+	memset(&pf_tss, 0, sizeof(struct tss));
+	pf_tss.ts_cr3 = (unsigned int) kernel_pd;
+	pf_tss.ts_eip = (unsigned int) _pf_entry_point;
+	pf_tss.ts_eflags = 0x00000002;
+	pf_tss.ts_esp = (unsigned int) &pf_stack[PF_STACK];
+	pf_tss.ts_cs = 0x8;
+	pf_tss.ts_ds = pf_tss.ts_es = pf_tss.ts_fs = pf_tss.ts_gs = 0x10;
+	pf_tss.ts_ss = 0x18;
+	pf_tss.ts_iomap = sizeof(struct tss);
+	set_tss(PFTSS, &pf_tss);
+
+	pidt = &idt[14];
+	pidt->igd_loffset = 0;
+	pidt->igd_segsel = PFTSS << 3;
+	pidt->igd_mbz = 0;
+	pidt->igd_type = IGDT_TASK;
+	pidt->igd_dpl = 0;
+	pidt->igd_present = 1;
+	pidt->igd_hoffset = 0;
+
+	i = KTSS << 3;
+	__asm __volatile("ltr %%ax" : : "a" (i));
+
+	/* enable paging, write protect also applies to ring 0 */
+	set_cr3(kernel_pd);
+	__asm __volatile( " 				\
+			movl	%%cr0, %%eax		\n\
+			orl	%0, %%eax		\n\
+			movl	%%eax, %%cr0		\n\
+			jmp	1f			\n\
+		1:					\n\
+			"
+			:
+			: "i" (CR0_PG | CR0_WP)
+			: "%eax"
+	);
+}
+
+/*
+* vm_commit
+*
+* @desc:	back a page of a stack reservation or heap arena with a page frame
+*
+* @param:	pd		page directory owning the stack or arena
+*		va		virtual address within the reserved stack or arena
+*
+* @output:	frame		page frame backing va, NULL when the page pool is exhausted
+*
+* @note:	the arena page table is only created on the first page the arena commits, and a page shared
+*		copy-on-write is made private, so the kernel may write to the returned frame
+*/
+static unsigned int *vm_commit(unsigned int *pd, unsigned int va)
+{
+	unsigned int *pt;
+	unsigned int *frame;
+
+	if(!(pd[PDX(va)] & PG_P))
+	{
+		pt = frame_alloc();
+		if(!pt) return NULL;
+
+		pd[PDX(va)] = (unsigned int) pt | PG_P | PG_RW;
+	}
+
+	pt = (unsigned int *) (pd[PDX(va)] & PG_FRAME);
+	if(!(pt[PTX(va)] & PG_P))
+	{
+		frame = frame_alloc();
+		if(!frame) return NULL;
+
+		pt[PTX(va)] = (unsigned int) frame | PG_P | PG_RW;
+	}
+	else if(!(pt[PTX(va)] & PG_RW))
+		return vm_unshare(&pt[PTX(va)]);
+
+	return (unsigned int *) (pt[PTX(va)] & PG_FRAME);
+}
+
+/*
+* vm_share
+*
+* @desc:	give a page directory a copy of the page table at va of another, with every present page shared 
+*		copy-on-write by both
+*
+* @param:	dpd		page directory getting the page table
+*		spd		page directory owning the page table
+*		va		virtual address within the page table
+*
+* @output:	SYSOK		page table shared, or spd has none at va
+*		SYSERR		page pool is exhausted
+*/
+static int vm_share(unsigned int *dpd, unsigned int *spd, unsigned int va)
+{
+	unsigned int *spt, *dpt;
+	int i;
+
+	if(!(spd[PDX(va)] & PG_P)) return SYSOK;
+
+	dpt = frame_alloc();
+	if(!dpt) return SYSERR;
+
+	spt = (unsigned int *) (spd[PDX(va)] & PG_FRAME);
+	for(i=0 ; i<PG_ENTRIES ; i++)
+	{
+		if(!(spt[i] & PG_P)) continue;
+
+		spt[i] &= ~PG_RW;
+		frame_refs[frame_index(spt[i] & PG_FRAME)]++;
+		dpt[i] = spt[i];
+	}
+
+	dpd[PDX(va)] = (unsigned int) dpt | PG_P | PG_RW;
+	return SYSOK;
+}
+
+/*
+* vm_release
+*
+* @desc:	free the committed stack pages at or below va, and the whole address space when va is the top of the stack
+*
+* @param:	pd		page directory owning the stack
+*		base		lowest address of the stack reservation
+*		va		highest address to release
+*/
+static void vm_release(unsigned int *pd, unsigned int base, unsigned int va)
+{
+	unsigned int *pt = (unsigned int *) (pd[PDX(VM_STACK_TOP-1)] & PG_FRAME);
+	unsigned int addr;
+
+	for(addr = base ; addr <= va && addr >= base ; addr += NBPG)
+	{
+		if(pt[PTX(addr)] & PG_P)
+		{
+			frame_free((void *) (pt[PTX(addr)] & PG_FRAME));
+			pt[PTX(addr)] = 0;
+		}
+	}
+
+	if(va >= VM_STACK_TOP-1)
+	{
+		frame_free(pt);
+		frame_free(pd);
+	}
+}
+
+/*
+* vm_scrub
+*
+* @desc:	clear the warm stack pages of an address space going into the stack cache, so the next proc does not
+*		see the stack of the last one
+*
+* @param:	pd		page directory owning the stack
+*
+* @output:	SYSOK		warm pages cleared, the top stack page is committed
+*		SYSERR		page pool is exhausted, the top stack page could not be committed again
+*
+* @note:	a page still shared copy-on-write belongs to another proc as well, it is dropped rather than cleared
+*/
+static int vm_scrub(unsigned int *pd)
+{
+	unsigned int *pt = (unsigned int *) (pd[PDX(VM_STACK_TOP-1)] & PG_FRAME);
+	unsigned int addr;
+
+	for(addr = VM_STACK_TOP - STACK_CACHE_WARM*NBPG ; addr < VM_STACK_TOP ; addr += NBPG)
+	{
+		if(!(pt[PTX(addr)] & PG_P))
+			continue;
+
+		if(pt[PTX(addr)] & PG_RW)
+			memset((void *) (pt[PTX(addr)] & PG_FRAME), 0, NBPG);
+		else
+		{
+			frame_free((void *) (pt[PTX(addr)] & PG_FRAME));
+			pt[PTX(addr)] = 0;
+		}
+	}
+
+	return vm_commit(pd, VM_STACK_TOP-1) ? SYSOK : SYSERR;
+}
+
+/*
+* vm_space
+*
+* @desc:	build a page directory sharing the kernel page tables, with a private stack page table and the top
+*		stack page committed
+*
+* @output:	pd		page directory, NULL when the page pool is exhausted
+*/
+static unsigned int *vm_space(void)
+{
+	unsigned int *pd, *pt;
+
+	pd = frame_alloc();
+	pt = frame_alloc();
+	if(!pd || !pt)
+	{
+		frame_free(pd);
+		frame_free(pt);
+		return NULL;
+	}
+
+	/* share the kernel page tables, the stack gets its own */
+	blkcopy(pd, kernel_pd, NBPG);
+	pd[PDX(VM_STACK_TOP-1)] = (unsigned int) pt | PG_P | PG_RW;
+
+	if(!vm_commit(pd, VM_STACK_TOP-1))
+	{
+		vm_release(pd, VM_STACK_TOP - NBPG, VM_STACK_TOP-1);
+		return NULL;
+	}
+
+	return pd;
+}
+
+/*
+* vm_alloc
+*
+* @desc:	give the proc an address space with its stack reserved right below VM_STACK_TOP, a cached 
+*		address space of the same stack size is reused when there is one
+*
+* @param:	p		proc to get a new address space
+*		stack		stack size to reserve, rounded up to a power of two pages
+*
+* @output:	SYSOK		address space ready, at least the top stack page is committed
+*		SYSERR		stack is larger than VM_STACK_MAX or the page pool is exhausted
+*/
+int vm_alloc(pcb_t *p, int stack)
+{
+	int order = page_order(stack);
+	unsigned int *pd;
+
+	if(order == SYSERR || (NBPG << order) > VM_STACK_MAX) return SYSERR;
+
+	if(stack_cache_cnt[order])
+	{
+		stack_cache_hits++;
+		pd = stack_cache[order][--stack_cache_cnt[order]];
+	}
+	else
+	{
+		stack_cache_misses++;
+		pd = vm_space();
+		if(!pd) return SYSERR;
+	}
+
+	p->pd = pd;
+	p->stack_base = VM_STACK_TOP - (NBPG << order);
+	p->heap_brk = VM_HEAP_BASE + NBPG;
+	return SYSOK;
+}
+
+/*
+* vm_fork
+*
+* @desc:	give the child proc a clone of the address space of its parent, the stack and heap arena pages are
+*		shared copy-on-write and only copied once either proc writes to them
+*
+* @param:	child		proc to get the address space, it has none
+*		parent		proc to be cloned
+*
+* @output:	SYSOK		address space cloned
+*		SYSERR		page pool is exhausted
+*
+* @note:	shared memory segments are not part of the clone, see shm_fork()
+*/
+int vm_fork(pcb_t *child, pcb_t *parent)
+{
+	unsigned int *pd;
+	int rc;
+
+	pd = frame_alloc();
+	if(!pd) return SYSERR;
+
+	blkcopy(pd, kernel_pd, NBPG);
+	child->pd = pd;
+	child->stack_base = parent->stack_base;
+	child->heap_brk = parent->heap_brk;
+
+	rc = vm_share(pd, parent->pd, VM_STACK_TOP-1);
+	if(rc == SYSOK)
+		rc = vm_share(pd, parent->pd, VM_HEAP_BASE);
+
+	/* drop the writable translations the parent still has cached */
+	if(parent == vm_current)
+		set_cr3(parent->pd);
+
+	if(rc == SYSERR)
+	{
+		vm_cut(child, VM_HEAP_BASE);
+		if(pd[PDX(VM_STACK_TOP-1)] & PG_P)
+			vm_release(pd, child->stack_base, VM_STACK_TOP-1);
+		else
+			frame_free(pd);
+
+		child->pd = NULL;
+	}
+
+	return rc;
+}
+
+/*
+* vm_free
+*
+* @desc:	release the heap arena of proc, then put its address space in the stack cache with the warm pages
+*		cleared, or release every committed stack page, the stack page table and the page directory when
+*		the cache for its stack size is full
+*
+* @param:	p		proc whose address space is released
+*
+* @note:	page_free() links free blocks through their first words, which would clobber the first kernel
+*		mappings of a live page directory, hence the kernel page directory is loaded first
+*/
+void vm_free(pcb_t *p)
+{
+	int order;
+
+	if(!p->pd) return;
+
+	if(p == vm_current)
+	{
+		vm_current = NULL;
+		main_tss.ts_cr3 = (unsigned int) kernel_pd;
+		set_cr3(kernel_pd);
+	}
+
+	/* the heap arena is never cached */
+	vm_cut(p, VM_HEAP_BASE);
+
+	order = page_order(VM_STACK_TOP - p->stack_base);
+	if(stack_cache_cnt[order] < STACK_CACHE_DEPTH)
+	{
+		/* keep the top of the stack warm, a deep stack does not pin its pages in the cache */
+		vm_release(p->pd, p->stack_base, VM_STACK_TOP - STACK_CACHE_WARM*NBPG - 1);
+		if(vm_scrub(p->pd) == SYSOK)
+			stack_cache[order][stack_cache_cnt[order]++] = p->pd;
+		else
+			vm_release(p->pd, p->stack_base, VM_STACK_TOP-1);
+	}
+	else
+		vm_release(p->pd, p->stack_base, VM_STACK_TOP-1);
+
+	p->pd = NULL;
+}
+
+/*
+* vm_grow
+*
+* @desc:	extend the heap arena of proc, the new pages are committed when they are first touched
+*
+* @param:	p		proc owning the arena
+*		size		number of bytes to add, rounded up to whole pages, 0 only queries the arena end
+*
+* @output:	addr		start of the added range, which is the previous end of the arena
+*		NULL		arena would exceed VM_HEAP_MAX
+*/
+void *vm_grow(pcb_t *p, unsigned int size)
+{
+	unsigned int brk = p->heap_brk;
+
+	size = PG_ROUND(size);
+	if(size > VM_HEAP_MAX || brk + size > VM_HEAP_BASE + VM_HEAP_MAX) return NULL;
+
+	p->heap_brk += size;
+	return (void *) brk;
+}
+
+/*
+* vm_shrink
+*
+* @desc:	move the end of the heap arena of proc down to addr, and release every committed page above it
+*
+* @param:	p		proc owning the arena
+*		addr		new end of the arena, rounded up to a page
+*
+* @output:	SYSOK		arena shrunk
+*		SYSERR		addr is outside of the arena, or would release the first arena page
+*/
+int vm_shrink(pcb_t *p, unsigned int addr)
+{
+	addr = PG_ROUND(addr);
+	if(addr < VM_HEAP_BASE + NBPG || addr > p->heap_brk) return SYSERR;
+
+	vm_cut(p, addr);
+	return SYSOK;
+}
+
+/*
+* vm_cut
+*
+* @desc:	release every committed arena page at or above addr, and the arena page table when addr is VM_HEAP_BASE
+*/
+static void vm_cut(pcb_t *p, unsigned int addr)
+{
+	unsigned int *pt, va;
+
+	if(p->pd[PDX(VM_HEAP_BASE)] & PG_P)
+	{
+		pt = (unsigned int *) (p->pd[PDX(VM_HEAP_BASE)] & PG_FRAME);
+		for(va = addr ; va < p->heap_brk ; va += NBPG)
+		{
+			if(pt[PTX(va)] & PG_P)
+			{
+				frame_free((void *) (pt[PTX(va)] & PG_FRAME));
+				pt[PTX(va)] = 0;
+			}
+		}
+
+		/* the whole arena is gone, so is its page table */
+		if(addr == VM_HEAP_BASE)
+		{
+			frame_free(pt);
+			p->pd[PDX(VM_HEAP_BASE)] = 0;
+		}
+
+		/* drop stale translations of the released pages */
+		if(p == vm_current)
+			set_cr3(p->pd);
+	}
+
+	p->heap_brk = addr;
+}
+
+/*
+* vm_map
+*
+* @desc:	install a page table shared with other proc at va, or remove it
+*
+* @param:	p		proc whose address space is changed
+*		va		virtual address of the page directory entry
+*		pt		shared page table, NULL removes the entry
+*
+* @note:	the page table is owned by the caller and is never freed by the address space
+*/
+void vm_map(pcb_t *p, unsigned int va, unsigned int *pt)
+{
+	if(!p->pd) return;
+
+	p->pd[PDX(va)] = pt ? (unsigned int) pt | PG_P | PG_RW : 0;
+
+	if(p == vm_current)
+		set_cr3(p->pd);
+}
+
+/*
+* stack_cache_init
+*
+* @desc:	pre-populate the stack cache with STACK_CACHE_PRELOAD address spaces for PROC_STACK stacks
+*/
+void stack_cache_init(void)
+{
+	int i, order = page_order(PROC_STACK);
+	unsigned int *pd;
+
+	for(i=0 ; i<STACK_CACHE_PRELOAD && stack_cache_cnt[order] < STACK_CACHE_DEPTH ; i++)
+	{
+		pd = vm_space();
+		if(!pd) break;
+
+		stack_cache[order][stack_cache_cnt[order]++] = pd;
+	}
+}
+
+/*
+* stack_cache_drain
+*
+* @desc:	release every cached address space back to the page allocator
+*
+* @output:	cnt		number of address spaces released
+*/
+int stack_cache_drain(void)
+{
+	int order, cnt=0;
+
+	for(order=0 ; order<BUDDY_ORDERS ; order++)
+	{
+		while(stack_cache_cnt[order])
+		{
+			vm_release(stack_cache[order][--stack_cache_cnt[order]], VM_STACK_TOP - (NBPG << order), VM_STACK_TOP-1);
+			cnt++;
+		}
+	}
+
+	return cnt;
+}
+
+/*
+* stack_cache_stats
+*
+* @desc:	get the stack cache hit and miss counters
+*
+* @param:	hits		number of vm_alloc() served from the cache
+*		misses		number of vm_alloc() that built a new address space
+*/
+void stack_cache_stats(unsigned int *hits, unsigned int *misses)
+{
+	*hits = stack_cache_hits;
+	*misses = stack_cache_misses;
+}
+
+/*
+* puts_stack_cache
+*
+* @desc:	output the number of cached address spaces for each stack size, and the hit and miss counters
+*/
+void puts_stack_cache()
+{
+	int order;
+
+	kprintf("stack_cache: ");
+	for(order=0 ; order<BUDDY_ORDERS ; order++)
+	{
+		if(stack_cache_cnt[order])
+			kprintf("%dK:%d ", (NBPG << order) / 1024, stack_cache_cnt[order]);
+	}
+	kprintf("(hit %d miss %d)\n", stack_cache_hits, stack_cache_misses);
+}
+
+/*
+* vm_switch
+*
+* @desc:	load the address space of proc before it is context switched into
+*
+* @note:	the processor does not save cr3 into the outgoing tss on a task switch, the kernel task
+*		therefore keeps the current page directory in main_tss to return to after a page fault
+*/
+void vm_switch(pcb_t *p)
+{
+	if(!p->pd) return;
+
+	vm_current = p;
+	main_tss.ts_cr3 = (unsigned int) p->pd;
+	set_cr3(p->pd);
+}
+
+/*
+* vm_fault
+*
+* @desc:	page fault handler, commits the faulting stack page of the current proc and the page
+*		below it since stacks grow downwards, or the faulting page of its heap arena, and copies
+*		a page shared copy-on-write on the first write to it
+*
+* @param:	err		page fault error code
+*
+* @note:	any other fault is fatal and halts the kernel, similar to trap()
+*/
+void vm_fault(unsigned int err)
+{
+	unsigned int va = get_cr2();
+	pcb_t *p = vm_current;
+
+	if(p && !(err & PF_PRESENT) && vm_stack(p, va) && vm_commit(p->pd, va))
+	{
+		if(vm_stack(p, va - NBPG))
+			vm_commit(p->pd, va - NBPG);
+		return;
+	}
+
+	if(p && !(err & PF_PRESENT) && vm_heap(p, va) && vm_commit(p->pd, va))
+		return;
+
+	/* write to a page shared copy-on-write */
+	if(p && (err & PF_PRESENT) && (err & PF_WRITE) && vm_demand(p, va) && vm_commit(p->pd, va))
+		return;
+
+	klog(KLOG_ERR, "page fault at %x (error %x) pid %d\n", va, err, p ? p->pid : INVALID_PID);
+	klog(KLOG_ERR, "\nHalting.....\n");
+	klog_flush();
+	for(;;);
+}
+
+/*
+* vm_fault_task
+*
+* @desc:	body of the page fault task
+*
+* @note:	the processor enters _pf_entry_point with the error code on the task stack, the iret
+*		returns to the kernel task and the next page fault resumes right after it
+*/
+void vm_fault_task(void)
+{
+	__asm __volatile( " 				\
+	_pf_entry_point:				\n\
+			call	vm_fault		\n\
+			addl	$4, %%esp		\n\
+			iret				\n\
+			jmp	_pf_entry_point		\n\
+			"
+			:
+			:
+			: "memory"
+	);
+}
+
+/*
+* vm_phys
+*
+* @desc:	translate a proc virtual address into an address the kernel can access from any
+*		address space
+*
+* @param:	p		proc owning va, NULL for a kernel address
+*		va		virtual address
+*
+* @output:	addr		identity mapped address, NULL when va is not mapped or can not be committed
+*
+* @note:	uncommitted stack and arena pages are committed, so the kernel can write below the current
+*		stack pointer of a proc that is not running, shared memory pages are always committed
+*/
+void *vm_phys(pcb_t *p, void *va)
+{
+	unsigned int *frame;
+
+	if(p && p->pd && (vm_demand(p, va) || shm_mapped(p, (unsigned int) va, 1)))
+	{
+		frame = vm_commit(p->pd, (unsigned int) va);
+		if(!frame) return NULL;
+
+		return (void *) ((unsigned int) frame + ((unsigned int) va & (NBPG-1)));
+	}
+
+	if((unsigned int) va <= (unsigned int) maxaddr)
+		return va;
+
+	return NULL;
+}
+
+/*
+* vm_copy
+*
+* @desc:	copy bytes between two address spaces
+*
+* @param:	dp		destination proc, NULL for a kernel address
+*		dst		destination virtual address
+*		sp		source proc, NULL for a kernel address
+*		src		source virtual address
+*		len		number of bytes to copy
+*
+* @output:	cnt		number of bytes copied, this is short of len when an address is not mapped
+*
+* @note:	the copy is split at page boundaries of either side, since contiguous virtual pages
+*		need not be contiguous frames. every page is translated through vm_phys() before it is
+*		touched, so the copy never faults and runs a word at a time when both sides share their
+*		alignment
+*/
+int vm_copy(pcb_t *dp, void *dst, pcb_t *sp, void *src, int len)
+{
+	unsigned char *d, *s;
+	unsigned int dva = (unsigned int) dst, sva = (unsigned int) src;
+	int cnt=0, chunk, i;
+
+	while(cnt < len)
+	{
+		d = vm_phys(dp, (void *) dva);
+		s = vm_phys(sp, (void *) sva);
+		if(!d || !s) break;
+
+		/* bytes left before either side crosses a page */
+		chunk = len - cnt;
+		if(chunk > NBPG - (dva & (NBPG-1)))
+			chunk = NBPG - (dva & (NBPG-1));
+		if(chunk > NBPG - (sva & (NBPG-1)))
+			chunk = NBPG - (sva & (NBPG-1));
+
+		i = 0;
+		if(!(((unsigned int) d ^ (unsigned int) s) & 3))
+		{
+			for( ; i<chunk && ((unsigned int) (d+i) & 3) ; i++)
+				d[i] = s[i];
+			for( ; i+4<=chunk ; i+=4)
+				*(unsigned int *) (d+i) = *(unsigned int *) (s+i);
+		}
+		for( ; i<chunk ; i++)
+			d[i] = s[i];
+
+		cnt += chunk;
+		dva += chunk;
+		sva += chunk;
+	}
+
+	return cnt;
+}
+
+/*
+* validate_range
+*
+* @desc:	check a buffer lies within memory a proc may pass to the kernel
+*
+* @param:	p		proc passing the buffer
+*		buf		buffer address
+*		len		buffer length
+*
+* @output:	TRUE		buffer is within the proc stack reservation, its heap arena, an attached shared
+*				memory segment, or within a heap region
+*		FALSE		buffer is below freemem, in the hole, in the frame pool or outside of usable memory
+*/
+Bool validate_range(pcb_t *p, void *buf, int len)
+{
+	unsigned int start = (unsigned int) buf, end = start + len;
+
+	if(len <= 0 || end < start) return FALSE;
+
+	if(vm_stack(p, start) && end <= VM_STACK_TOP)
+		return TRUE;
+
+	if(vm_heap(p, start) && end <= p->heap_brk)
+		return TRUE;
+
+	if(shm_mapped(p, start, len))
+		return TRUE;
+
+	return kmemvalid(buf, len);
+}
+
+/*
+* copy_to_user
+*
+* @desc:	copy a kernel buffer into a buffer of proc
+*
+* @param:	p		proc owning dst
+*		dst		proc buffer
+*		src		kernel buffer
+*		len		number of bytes to copy
+*
+* @output:	cnt		number of bytes copied, SYSERR when dst does not pass validate_range()
+*/
+int copy_to_user(pcb_t *p, void *dst, void *src, int len)
+{
+	if(!validate_range(p, dst, len)) return SYSERR;
+	return vm_copy(p, dst, NULL, src, len);
+}
+
+/*
+* copy_from_user
+*
+* @desc:	copy a buffer of proc into a kernel buffer
+*
+* @param:	p		proc owning src
+*		dst		kernel buffer
+*		src		proc buffer
+*		len		number of bytes to copy
+*
+* @output:	cnt		number of bytes copied, SYSERR when src does not pass validate_range()
+*/
+int copy_from_user(pcb_t *p, void *dst, void *src, int len)
+{
+	if(!validate_range(p, src, len)) return SYSERR;
+	return vm_copy(NULL, dst, p, src, len);
+}
+
+/*
+* copy_str_from_user
+*
+* @desc:	copy a nul terminated string of proc into a kernel buffer, a chunk at a time
+*
+* @param:	p		proc owning src
+*		dst		kernel buffer, always nul terminated
+*		src		proc string
+*		len		kernel buffer length, a longer string is cut short
+*
+* @output:	cnt		length of the string copied, SYSERR when a chunk before the nul does not pass validate_range()
+*
+* @note:	a chunk never crosses a STR_CHUNK boundary, every range validate_range() accepts starts and ends on one,
+*		so a string ending right before an invalid byte is still copied
+*/
+int copy_str_from_user(pcb_t *p, char *dst, char *src, int len)
+{
+	int cnt = 0, chunk, i;
+
+	if(len <= 0) return SYSERR;
+
+	while(cnt < len-1)
+	{
+		chunk = STR_CHUNK - ((unsigned int) (src + cnt) & (STR_CHUNK-1));
+		if(chunk > len-1 - cnt)
+			chunk = len-1 - cnt;
+
+		if(copy_from_user(p, dst + cnt, src + cnt, chunk) != chunk)
+			return SYSERR;
+
+		for(i=0 ; i<chunk && dst[cnt+i] ; i++);
+		cnt += i;
+		if(i < chunk)
+			break;
+	}
+
+	dst[cnt] = '\0';
+	return cnt;
+}
+
+/*
+* clear_user
+*
+* @desc:	zero fill a buffer of proc
+*
+* @param:	p		proc owning dst
+*		dst		proc buffer
+*		len		number of bytes to clear
+*
+* @output:	cnt		number of bytes cleared, SYSERR when dst does not pass validate_range()
+*/
+int clear_user(pcb_t *p, void *dst, int len)
+{
+	unsigned char *d;
+	unsigned int va = (unsigned int) dst;
+	int cnt=0, chunk;
+
+	if(!validate_range(p, dst, len)) return SYSERR;
+
+	while(cnt < len)
+	{
+		d = vm_phys(p, (void *) va);
+		if(!d) break;
+
+		chunk = len - cnt;
+		if(chunk > NBPG - (va & (NBPG-1)))
+			chunk = NBPG - (va & (NBPG-1));
+
+		memset(d, 0, chunk);
+		cnt += chunk;
+		va += chunk;
+	}
+
+	return cnt;
+}
@@ -0,0 +1,37 @@
+/* Console Device Driver
+ *
+ * This file defines the macros for the console device driver
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* ============== */
+/* console device */
+
+
+/* console device constants */
+#ifndef CONS_RING_SZ
+#define CONS_RING_SZ		1024	/* output held until the next flush, a power of two */
+#endif
+#define CONS_RING_MASK		(CONS_RING_SZ - 1)
+
+#define DEV_SUCCESS		0
+#define DEV_ERR			-1
+
+/* console device */
+extern int cons_open(devsw_t* d, fd_t *f);
+extern int cons_close(devsw_t* d, fd_t *f);
+extern int cons_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen);
+extern int cons_poll(devsw_t* d, fd_t *f, unsigned int events);
@@ -65,6 +65,7 @@ struct sd {
 /* System Descriptor Types */
 
 #define	SDT_INTG	14	/* Interrupt Gate	*/
+#define	SDT_TSS		9	/* Available 32-bit TSS	*/
 
 /* Segment Table Register */
 struct segtr {
@@ -93,6 +94,91 @@ struct segtr {
 #define HOLEEND         ((1024 + HOLESIZE) * 1024)
 /* Extra 600 for bootp loading, and monitor */
 
+/* BIOS data left at 0x90000 by boot/setup.S
+ */
+#define EXT_MEM_K	0x90002		/* extended memory above 1MB in KB (int 0x15, ah=0x88)	*/
+#define E820_MAP	0x900a0		/* e820 records						*/
+#define E820_NR		0x901e8		/* number of e820 records, 1 byte			*/
+#define E820_SIG	0x901ec		/* E820_SMAP once setup has probed the map		*/
+#define E820_SMAP	0x534d4150	/* ascii 'SMAP'						*/
+#define E820_MAX	16
+#define E820_RAM	1		/* usable memory record type				*/
+#define RAMDISK_K	0x901f8		/* size in KB of the ramdisk image appended by boot/build.c, 2 bytes	*/
+#define RAMDISK_END	0x80000		/* the image ends here once setup has moved the system to 0x1000	*/
+
+struct e820 {
+	unsigned int	addr_lo, addr_hi;
+	unsigned int	size_lo, size_hi;
+	unsigned int	type;
+};
+
+#define MEM_LIMIT	0xC0000000	/* memory above is not used, the top of the address space holds proc stacks */
+
+/* Paging
+ */
+#define PG_P		0x001		/* page present				*/
+#define PG_RW		0x002		/* page writable			*/
+#define PG_FRAME	0xfffff000	/* page frame address mask		*/
+#define PG_ENTRIES	1024		/* entries in a page directory/table	*/
+#define PG_SPAN		(PG_ENTRIES*NBPG)	/* bytes mapped by one page table	*/
+
+#define PDX(va)		(((unsigned int)(va) >> 22) & 0x3ff)	/* page directory index	*/
+#define PTX(va)		(((unsigned int)(va) >> 12) & 0x3ff)	/* page table index	*/
+#define PG_ROUND(x)	(((unsigned int)(x) + NBPG-1) & PG_FRAME)
+
+#define CR0_WP		0x00010000	/* supervisor write protect (486+)	*/
+#define CR0_PG		0x80000000	/* paging enable			*/
+
+#define PF_PRESENT	0x1		/* page fault error code, page was present	*/
+#define PF_WRITE	0x2		/* page fault error code, write access		*/
+
+/* every proc stack is reserved right below VM_STACK_TOP in its own address space,
+ * the region is mapped by a single page table, hence VM_STACK_MAX 
+ */
+#define VM_STACK_TOP	0xF0000000
+#define VM_STACK_MAX	PG_SPAN
+
+/* every proc heap arena starts at VM_HEAP_BASE in its own address space, the first page
+ * is always part of the arena and holds the user allocator state
+ */
+#define VM_HEAP_BASE	0xD0000000
+#define VM_HEAP_MAX	PG_SPAN
+
+/* shared memory segment i is mapped at VM_SHM_BASE + i*PG_SPAN by its own page table, at the
+ * same virtual address in every proc that attaches it
+ */
+#define VM_SHM_BASE	0xE0000000
+#define VM_SHM_MAX	PG_SPAN
+
+/* Task State Segment
+ */
+struct tss {
+	unsigned short	ts_link, ts_rsvd0;
+	unsigned int	ts_esp0;
+	unsigned short	ts_ss0, ts_rsvd1;
+	unsigned int	ts_esp1;
+	unsigned short	ts_ss1, ts_rsvd2;
+	unsigned int	ts_esp2;
+	unsigned short	ts_ss2, ts_rsvd3;
+	unsigned int	ts_cr3;
+	unsigned int	ts_eip;
+	unsigned int	ts_eflags;
+	unsigned int	ts_eax, ts_ecx, ts_edx, ts_ebx;
+	unsigned int	ts_esp, ts_ebp, ts_esi, ts_edi;
+	unsigned short	ts_es, ts_rsvd4;
+	unsigned short	ts_cs, ts_rsvd5;
+	unsigned short	ts_ss, ts_rsvd6;
+	unsigned short	ts_ds, ts_rsvd7;
+	unsigned short	ts_fs, ts_rsvd8;
+	unsigned short	ts_gs, ts_rsvd9;
+	unsigned short	ts_ldt, ts_rsvd10;
+	unsigned short	ts_trap;
+	unsigned short	ts_iomap;
+};
+
+#define	KTSS		5	/* gdt entry of the kernel task, saved on a page fault	*/
+#define	PFTSS		6	/* gdt entry of the page fault task			*/
+
 /* Code grokked from cs452 (waterloo) libs
  */
 #define TIMER_IRQ	0	/* IRQ of counter 0 on timer 1 */
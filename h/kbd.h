@@ -28,22 +28,27 @@
 
 #define ENTER_KEY		10
 
+#ifndef KBD_RING_SZ
+#define KBD_RING_SZ		256	/* typed-ahead keystrokes kept while no reader takes them, a power of two */
+#endif
+#define KBD_RING_MASK		(KBD_RING_SZ - 1)
+
 
 #define DEV_SUCCESS		0
 #define DEV_ERR			-1
 
 /* keyboard device */
 extern void kbd_init();
-extern int kbd_open(devsw_t* d);
-extern int kbd_close(devsw_t* d);
-extern int kbd_write(devsw_t* d, void* buf, int buflen);
-extern int kbd_read(pcb_t *p, devsw_t* d, void* buf, int buflen);
-extern int kbd_ioctl(int eof);
+extern int kbd_open(devsw_t* d, fd_t *f);
+extern int kbd_close(devsw_t* d, fd_t *f);
+extern int kbd_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen);
+extern int kbd_read(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen);
+extern int kbd_ioctl(devsw_t* d, fd_t *f, unsigned long command, int eof);
+extern int kbd_cancel(devsw_t* d, pcb_t *p, fd_t *f);
+extern int kbd_poll(devsw_t* d, fd_t *f, unsigned int events);
 extern int kbd_iint();
-extern int kbd_error();
 extern void kbd_notify();
 
 
-extern void kbd_enqueue(pcb_t *p);
 extern void kbd_dequeue();
 extern void puts_kbd_q();
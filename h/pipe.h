@@ -0,0 +1,48 @@
+/* Pipe Device Driver
+ *
+ * This file defines the macros for the pipe device driver
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* =========== */
+/* pipe device */
+
+
+/* pipe device constants */
+#ifndef PIPE_SZ
+#define PIPE_SZ			8	/* pipes open at once 					*/
+#endif
+#ifndef PIPE_RING_SZ
+#define PIPE_RING_SZ		4096	/* bytes buffered in each pipe, a power of two 		*/
+#endif
+#define PIPE_RING_MASK		(PIPE_RING_SZ - 1)
+#define PIPE_LOWAT		(PIPE_RING_SZ / 4)	/* blocked writers resume once the ring drains to here 	*/
+#define PIPE_HIWAT		(PIPE_RING_SZ * 3 / 4)	/* the write end polls writable once the ring drains to here */
+
+#define PIPE_RD			0	/* minor of a pipe end is the pipe index << 1 | PIPE_RD or PIPE_WR */
+#define PIPE_WR			1
+
+#define DEV_SUCCESS		0
+#define DEV_ERR			-1
+
+/* pipe device */
+extern int pipe_open(devsw_t* d, fd_t *f);
+extern int pipe_ref(devsw_t* d, fd_t *f, int delta);
+extern int pipe_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen);
+extern int pipe_read(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen);
+extern int pipe_cancel(devsw_t* d, pcb_t *p, fd_t *f);
+extern int pipe_poll(devsw_t* d, fd_t *f, unsigned int events);
+extern void puts_pipe();
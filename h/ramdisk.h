@@ -0,0 +1,38 @@
+/* RAM Disk Device Driver
+ *
+ * This file defines the macros for the ram disk device driver
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* =============== */
+/* ram disk device */
+
+
+/* ram disk device constants */
+#ifndef RAMDISK_SZ
+#define RAMDISK_SZ		(64*1024)	/* size of an empty disk, when the boot image carries none */
+#endif
+
+#define DEV_SUCCESS		0
+#define DEV_ERR			-1
+
+/* ram disk device */
+extern int ram_open(devsw_t* d, fd_t *f);
+extern int ram_close(devsw_t* d, fd_t *f);
+extern int ram_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen);
+extern int ram_read(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen);
+extern int ram_ioctl(devsw_t* d, fd_t *f, unsigned long command, int arg);
+extern int ram_poll(devsw_t* d, fd_t *f, unsigned int events);
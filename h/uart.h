@@ -0,0 +1,85 @@
+/* Serial Device Driver
+ *
+ * This file defines the macros for the 16550 serial device driver
+ *
+ * bkernel is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * bkernel is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Foobar. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* ============= */
+/* serial device */
+
+
+/* COM1 ports, offsets from UART_BASE */
+#define UART_BASE		0x3F8
+#define UART_IRQ		4
+#define UART_DATA		0	/* receive buffer / transmit holding, divisor low with LCR_DLAB	*/
+#define UART_IER		1	/* interrupt enable, divisor high with LCR_DLAB 			*/
+#define UART_IIR		2	/* interrupt identification on read 					*/
+#define UART_FCR		2	/* fifo control on write 						*/
+#define UART_LCR		3	/* line control 							*/
+#define UART_MCR		4	/* modem control 							*/
+#define UART_LSR		5	/* line status 								*/
+#define UART_MSR		6	/* modem status 							*/
+
+#define IER_RDA			0x01	/* received data available 		*/
+#define IER_THRE		0x02	/* transmit holding register empty 	*/
+#define IER_RLS			0x04	/* receiver line status 		*/
+
+#define IIR_NONE		0x01	/* no interrupt pending 		*/
+#define IIR_ID			0x0e
+#define IIR_MSR			0x00
+#define IIR_THRE		0x02
+#define IIR_RDA			0x04
+#define IIR_RLS			0x06
+#define IIR_TIMEOUT		0x0c	/* characters idle in the receive fifo 	*/
+
+#define FCR_ENABLE		0x01
+#define FCR_CLEAR		0x06	/* clear both fifos 			*/
+#define FCR_TRIGGER_14		0xc0	/* interrupt with 14 bytes received 	*/
+
+#define LCR_8N1			0x03
+#define LCR_DLAB		0x80
+
+#define MCR_DTR			0x01
+#define MCR_RTS			0x02
+#define MCR_OUT2		0x08	/* gates the interrupt line on a PC 	*/
+
+#define LSR_DR			0x01	/* data ready 				*/
+#define LSR_THRE		0x20	/* transmit fifo empty 			*/
+
+#define UART_FIFO		16	/* bytes the transmit fifo takes once empty */
+
+/* serial device constants */
+#ifndef UART_DIVISOR
+#define UART_DIVISOR		1	/* 115200 baud */
+#endif
+#ifndef UART_RING_SZ
+#define UART_RING_SZ		1024	/* bytes queued each way, a power of two */
+#endif
+#define UART_RING_MASK		(UART_RING_SZ - 1)
+
+
+#define DEV_SUCCESS		0
+#define DEV_ERR			-1
+
+/* serial device */
+extern int uart_open(devsw_t* d, fd_t *f);
+extern int uart_close(devsw_t* d, fd_t *f);
+extern int uart_write(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen);
+extern int uart_read(pcb_t *p, devsw_t* d, fd_t *f, void* buf, int buflen);
+extern int uart_cancel(devsw_t* d, pcb_t *p, fd_t *f);
+extern int uart_poll(devsw_t* d, fd_t *f, unsigned int events);
+extern int uart_iint();
+extern void puts_uart();
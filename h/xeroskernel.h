@@ -55,6 +55,7 @@ typedef char            Bool;           /* boolean type
 #define ERR_SIGNAL_SIG_NO		-2	/* invalid sig number in signal () 							*/
 #define ERR_SIGNAL_HANDLER_SIG_NO	-1	/* invalid sig number in siginstall() 							*/
 #define ERR_SIGNAL_HANDLER		-2	/* invalid handler address 								*/
+#define ERR_SIGNAL_STACK		-3	/* no room on the proc stack for the signal stack in sigdeliver()			*/
 #define ERR_SIGNAL_UNBLOCK_SYSCALL	-128	/* system interrupted by signal, this return value does not allow to syssleep () 	*/
 
 
@@ -67,6 +68,8 @@ typedef char            Bool;           /* boolean type
 #define BLOCK_ON_SIG_STATE     	5
 #define BLOCK_ON_DEV_STATE     	6
 #define STOP_STATE              7
+#define RT_WAIT_STATE           8       /* periodic real-time proc waiting for its next release */
+#define BLOCK_ON_POLL_STATE     9       /* proc waiting in syspoll() for any of a set of events */
 
 
 /* user process constants */
@@ -76,7 +79,9 @@ typedef char            Bool;           /* boolean type
 #define PROC_SZ        	32              
 #define SIG_SZ		32
 #define FD_SZ		4
-#define DEV_SZ		2
+#ifndef DEV_SZ
+#define DEV_SZ		8		/* device majors, see di_register() 		*/
+#endif
 
 #define RECEIVE_ANY_PID 0               /* ipc_recv call for receiving from any proc    */
 #define IDLE_PROC_PID   65536           /* this pid is also used as the pid bound       */
@@ -84,8 +89,96 @@ typedef char            Bool;           /* boolean type
 #define MIN_STACK       1024    
 
 
+/* memory constants */
+#define MEM_REGIONS     8               /* usable physical memory regions kept from the e820 map    */
+#ifndef PAGE_POOL_SZ
+#define PAGE_POOL_SZ    (4*1024*1024)   /* page pool at the top of memory for the buddy allocator, it
+                                         * is capped at half of the highest region, the heap ends at
+                                         * the pool                                                 */
+#endif
+#define BUDDY_ORDERS    11              /* buddy blocks of 2^0 .. 2^10 pages                        */
+#define KMEM_CLASSES    10              /* allocator stats size classes, [16,32) .. [8192,...)      */
+#ifndef KMEM_TRACE_SZ
+#define KMEM_TRACE_SZ   64              /* kmalloc/kfree records kept while tracing, 0 to disable   */
+#endif
+#define KMEM_ALLOC      1               /* trace record of a kmalloc()                              */
+#define KMEM_FREE       2               /* trace record of a kfree()                                */
+
+/* stack cache, address spaces of stopped proc are kept for reuse by stack size */
+#define STACK_CACHE_DEPTH       4       /* address spaces kept per stack size                       */
+#define STACK_CACHE_WARM        2       /* top stack pages that stay committed while cached         */
+#ifndef STACK_CACHE_PRELOAD
+#define STACK_CACHE_PRELOAD     2       /* PROC_STACK address spaces built at boot, 0 to disable    */
+#endif
+
+/* shared memory constants */
+#define SHM_SZ          16              /* shared memory segments, at most 32 for the attach mask   */
+
+/* poll constants */
+#define POLL_SZ         16              /* entries in a syspoll() set                               */
+#define POLL_FD         0               /* poll entry kinds: an open fd, id is the fd               */
+#define POLL_MSG        1               /* a proc blocked sending to the caller, id is its pid or 0 */
+#define POLL_SIG        2               /* pending signals, id is a mask of signal bits             */
+#define POLLIN          0x1             /* poll events: data can be read, or the entry is pending   */
+#define POLLOUT         0x2             /* data can be written                                      */
+#define POLLERR         0x4             /* entry is not valid, always reported                      */
+
+/* buffer cache constants */
+#define BLK_SZ          512             /* block size of every block device                         */
+#ifndef BCACHE_SZ
+#define BCACHE_SZ       64              /* blocks held by the buffer cache                          */
+#endif
+#define BCACHE_HASH     32              /* buffer cache hash buckets, a power of two                */
+
+/* kernel log constants, levels follow syslog */
+#define KLOG_ERR        3
+#define KLOG_WARN       4
+#define KLOG_INFO       6               /* level of kprintf() records                               */
+#define KLOG_DEBUG      7
+#ifndef KLOG_SZ
+#define KLOG_SZ         8192            /* log bytes kept, a power of two                           */
+#endif
+#ifndef KLOG_BATCH
+#define KLOG_BATCH      512             /* log bytes drained to the screen per timer tick           */
+#endif
+#ifndef KLOG_CONSOLE_LEVEL
+#define KLOG_CONSOLE_LEVEL KLOG_DEBUG   /* records above this level are only kept in the log        */
+#endif
+#define KLOG_LINE       128             /* bytes formatted before they are appended to the log      */
+#define PUTS_SZ         128             /* longest sysputs() string, a longer one is cut short      */
+
+
 /* hardware timer constant */
-#define CLOCK_DIVISOR   100     
+#ifndef CLOCK_DIVISOR
+#define CLOCK_DIVISOR   100             /* boot tick rate in Hz, override with -DCLOCK_DIVISOR=<hz> */
+#endif
+#define CLOCK_HZ_MIN    20              /* slowest tick rate the 16-bit PIT divisor can hold        */
+#define CLOCK_HZ_MAX    1000
+#define QUANTUM_MS_MAX  1000            /* longest sysquantum(), a proc can not hold the cpu longer */
+
+
+/* scheduler constants */
+#define SCHED_FIFO	0		/* single round-robin queue, 1 tick quantum for every proc		*/
+#define SCHED_MLFQ	1		/* multilevel feedback queue, procs drop a level on a full quantum	*/
+
+#define SCHED_LEVELS	3		/* number of ready_q levels, level 0 is the highest priority		*/
+#define SCHED_QUANTUM_0	1		/* quantum in timer ticks for each level 				*/
+#define SCHED_QUANTUM_1	2
+#define SCHED_QUANTUM_2	4
+#define SCHED_BOOST	50		/* timer ticks between priority boosts of all procs to level 0		*/
+
+#define SCHED_HINT_LATENCY 0		/* latency-sensitive proc, queued ahead of normal proc once it has waited	*/
+#define SCHED_HINT_NORMAL  1		/* default hint for every created proc					*/
+#define SCHED_HINT_BATCH   2		/* batch proc, queued behind normal proc on its level			*/
+
+#define SCHED_CLASS_TS	0		/* time sharing proc, dispatched through ready_q			*/
+#define SCHED_CLASS_RT	1		/* periodic real-time proc, dispatched earliest deadline first		*/
+
+
+/* real-time constants */
+#define RT_UTIL_MAX	1000		/* admission bound on the sum of budget/deadline in per-mille		*/
+#define ERR_RT_PARAM	-1		/* invalid period, budget or deadline					*/
+#define ERR_RT_ADMIT	-2		/* admitting the proc would overload the real-time class		*/
 
 
 /* sleep constants */
@@ -102,13 +195,30 @@ typedef char            Bool;           /* boolean type
 /* device constants */
 #define KBD_NECHO	0
 #define KBD_ECHO	1
+#define CONSOLE		2
+#define SERIAL		3
+#define PIPE		4
+#define RAMDISK		5
+#define DEV_MINOR(n)	((n) << 8)	/* device_no for sysopen() is a major number or'ed with a minor */
+#define DEV_MAJOR(n)	((n) & 0xff)
+#define DEV_MINOR_OF(n)	(((n) >> 8) & 0xff)
 #define SET_EOF		100
+#define SET_FLAGS	101		/* sysioctl() commands handled for every device, see di_ioctl() */
+#define GET_FLAGS	102
+#define SET_ASYNC_SIG	103		/* signal raised when an O_ASYNC read completes 		*/
+#define GET_ASYNC	104		/* result of the last O_ASYNC read, BLOCKERR while pending 	*/
+#define BLK_SEEK	105		/* block device commands, set the fd offset in bytes 		*/
+#define BLK_SIZE	106		/* get the device size in bytes 				*/
+#define BLK_SYNC	107		/* write back the dirty cached blocks of the device 		*/
+#define O_NONBLOCK	0x1		/* reads and writes return BLOCKERR instead of blocking 	*/
+#define O_ASYNC		0x2		/* reads return at once and complete in the background 		*/
 
 
 /* ================================ */
 /* interrupt descriptor table entry */
 #define TIMER_INT       1
 #define KBD_INT       	2
+#define UART_INT	3
 #define KERNEL_INT      64
 
 
@@ -122,6 +232,23 @@ typedef char            Bool;           /* boolean type
 #define SLEEP           105
 #define SEND            106
 #define RECV            107
+#define SCHED_INFO      108
+#define RT_SET          109
+#define RT_WAIT         110
+#define YIELD_TO        111
+#define SCHED_HINT      112
+#define QUANTUM         113
+#define CLOCK           114
+#define MALLOC          115
+#define FREE            116
+#define SHM_CREATE      117
+#define SHM_ATTACH      118
+#define SHM_DETACH      119
+#define MEM_STATS       120
+#define FORK            121
+#define SYSLOG_READ     122
+#define POLL            123
+#define MEM_TRACE       124
 
 #define SIG_HANDLER	1000
 #define SIG_RETURN	1001
@@ -133,6 +260,15 @@ typedef char            Bool;           /* boolean type
 #define DEV_WRITE	2002
 #define DEV_READ	2003
 #define DEV_IOCTL	2004
+#define DEV_PIPE	2005
+
+
+/* ================ */
+/* scheduler policy */
+#ifndef SCHED_POLICY
+/* change to SCHED_MLFQ to enable the multilevel feedback queue scheduler */
+#define SCHED_POLICY	SCHED_FIFO
+#endif
 
 
 /* ========= */
@@ -257,18 +393,103 @@ typedef char            Bool;           /* boolean type
 #endif
 
 
+/* ========== */
+/* poll tests */
+#ifndef POLL_TEST
+/* uncomment to enable syspoll tests, once this is uncommented polltest_root() will be created */
+//#define POLL_TEST
+#endif
+
+
+/* ========== */
+/* pipe tests */
+#ifndef PIPE_TEST
+/* uncomment to enable syspipe tests, once this is uncommented pipetest_root() will be created */
+//#define PIPE_TEST
+#endif
+
+
+/* ============= */
+/* ramdisk tests */
+#ifndef RAMDISK_TEST
+/* uncomment to enable ramdisk tests, once this is uncommented ramtest_root() will be created */
+//#define RAMDISK_TEST
+#endif
+
+
+/* ============== */
+/* keyboard tests */
+#ifndef KBD_TEST
+/* uncomment to enable keyboard type-ahead tests, once this is uncommented kbdtest_root() will be created */
+//#define KBD_TEST
+#endif
+
+
+/* ======== */
+/* fd tests */
+#ifndef FD_TEST
+/* uncomment to enable multi-open and pipe end tests, once this is uncommented fdtest_root() will be created */
+//#define FD_TEST
+#endif
+
+
+/* =========== */
+/* async tests */
+#ifndef ASYNC_TEST
+/* uncomment to enable O_NONBLOCK and O_ASYNC read tests, once this is uncommented asynctest_root() will be created */
+//#define ASYNC_TEST
+#endif
+
+
 /* ====================== */
 /* system data structures */
+typedef struct mem_region mem_region_t;
+struct mem_region
+{
+        unsigned int start;             /* first byte of usable memory, page aligned                    */
+        unsigned int end;               /* first byte past usable memory, page aligned                  */
+};
+
+/* the last word of every heap block is a footer pointing back at its header, see kfree() */
 typedef struct memHeader memHeader_t;
 struct memHeader 
 { 
         unsigned long size;             /* size of the memory block after the memory header             */
         memHeader_t *prev;              /* link to previous memory block that is lower in address       */
         memHeader_t *next;              /* link to next memory block that is higher in address          */
-        char *sanityCheck;              /* corrupt check for memory block                               */
+        char *sanityCheck;              /* corrupt check for memory block, also tells free blocks apart */
         unsigned char dataStart[0];     /* start of the data portion of a memory block                  */
 }; 
 
+typedef struct kmem_stats kmem_stats_t;
+struct kmem_stats
+{
+	unsigned int in_use;			/* bytes allocated, headers and page rounding included	*/
+	unsigned int peak;			/* highest in_use since boot				*/
+	unsigned int allocs;			/* successful kmalloc()					*/
+	unsigned int frees;			/* successful kfree()					*/
+	unsigned int failures;			/* kmalloc() that returned NULL				*/
+	unsigned int bad_frees;			/* kfree() of an address that is not allocated		*/
+	unsigned int searches;			/* first-fit list walks					*/
+	unsigned int search_steps;		/* blocks visited over all walks, the average search
+						 * length is search_steps / searches			*/
+	unsigned int classes[KMEM_CLASSES];	/* allocations by requested size class			*/
+	unsigned int free_blocks[KMEM_CLASSES];	/* free list blocks by size class			*/
+	unsigned int free_bytes;		/* free list bytes					*/
+	unsigned int largest_free;		/* largest free list block				*/
+	unsigned int stack_hits;		/* address spaces reused from the stack cache		*/
+	unsigned int stack_misses;		/* address spaces built because the cache was empty	*/
+};
+
+typedef struct kmem_trace kmem_trace_t;
+struct kmem_trace
+{
+	unsigned int op;			/* KMEM_ALLOC or KMEM_FREE				*/
+	void *ptr;				/* block address, NULL for a failed kmalloc()		*/
+	unsigned int size;			/* requested size, or block size for a kfree()		*/
+	void *caller;				/* return address into the caller			*/
+};
+
 
 typedef struct ipc ipc_t;               
 struct ipc
@@ -282,7 +503,12 @@ struct ipc
 typedef struct fd fd_t;
 struct fd
 {
-	int dvmajor;
+	int dvmajor;			/* device major number, -1 for a free entry 	*/
+	int dvminor;			/* device unit, from DEV_MINOR() at open 	*/
+	unsigned int flags;		/* per-open flags 				*/
+	unsigned int offset;		/* position for seekable devices 		*/
+	int async_sig;			/* signal raised on O_ASYNC completion, -1 for none */
+	int async_rc;			/* result of the last O_ASYNC read 		*/
 };
 
 typedef struct pcb pcb_t;
@@ -292,6 +518,10 @@ struct pcb
         unsigned int state;             /* process state currently in the system                                        */
         unsigned int esp;               /* process stack pointer                                                        */
         unsigned int *mem;              /* process memory 'dataStart' pointer                                           */
+        unsigned int *pd;               /* process page directory                                                       */
+        unsigned int stack_base;        /* lowest virtual address of the reserved stack, the stack ends at VM_STACK_TOP */
+        unsigned int heap_brk;          /* end of the heap arena, the arena starts at VM_HEAP_BASE                      */
+        unsigned int shm_mask;          /* shared memory segments attached by the proc, one bit per segment             */
         unsigned int args;              /* retains all arguments passed from a syscall()                                */
         int rc;                		/* return code from syscall()                                                   */
 
@@ -300,6 +530,22 @@ struct pcb
 	unsigned int sig_install_mask;	/* signals with an installed handler 						*/
 	unsigned int sig_ignore_mask;	/* ignored signals (toggled as 0) 						*/
 
+        unsigned int level;             /* ready_q level the proc is queued on, always 0 for SCHED_FIFO                 */
+        unsigned int slice;             /* timer ticks left in the current quantum                                      */
+        unsigned int hint;              /* scheduler hint, orders procs within a ready_q level                          */
+        Bool waited;                    /* proc waited on an event since it last ran, only then is it queued by hint    */
+        unsigned int quantum_ms;        /* proc quantum in milliseconds set by sysquantum(), 0 uses the level quantum   */
+
+        unsigned int sched_class;       /* SCHED_CLASS_TS or SCHED_CLASS_RT                                             */
+        unsigned int rt_period;         /* real-time period in ticks                                                    */
+        unsigned int rt_budget;         /* real-time execution budget per period in ticks                               */
+        unsigned int rt_deadline;       /* real-time deadline in ticks, relative to the job release                     */
+        unsigned int rt_release;        /* absolute tick the current job was released at                                */
+        unsigned int rt_abs_deadline;   /* absolute tick the current job is due at, this is the key for the rt_q        */
+        unsigned int rt_used;           /* ticks consumed by the current job                                            */
+        unsigned int rt_overruns;       /* number of jobs that used up their budget before sysrtwait()                  */
+        unsigned int rt_misses;         /* number of jobs that completed after their deadline                           */
+
         unsigned int delta_slice;       /* process time slices to sleep for,
                                         *  this value is stored as a key in the delta list for sleep queue              */
 
@@ -312,6 +558,22 @@ struct pcb
         pcb_t *next;                    /* link to the next pcb block, two queues exist in the os, ready and stop       */
 };
 
+typedef struct sched_info sched_info_t;
+struct sched_info
+{
+	unsigned int policy;			/* SCHED_FIFO or SCHED_MLFQ				*/
+	unsigned int levels;			/* number of ready_q levels in use			*/
+	unsigned int quantum[SCHED_LEVELS];	/* quantum in ticks for each level			*/
+	unsigned int boost;			/* ticks between priority boosts, 0 if disabled		*/
+	unsigned int level;			/* current level of the calling proc			*/
+	unsigned int hint;			/* current scheduler hint of the calling proc		*/
+	unsigned int slice;			/* quantum in ticks of the calling proc			*/
+	unsigned int hz;			/* current timer tick rate				*/
+	unsigned int ticks;			/* timer ticks since the dispatcher started		*/
+	unsigned int idle_ticks;		/* timer ticks spent in the idle proc, cpu utilisation
+						 * is (ticks - idle_ticks) / ticks			*/
+};
+
 typedef struct context_frame context_frame_t;
 struct context_frame 
 {
@@ -332,10 +594,34 @@ struct context_frame
                                         */
 };
 
+typedef struct pollfd pollfd_t;
+struct pollfd
+{
+	int kind;			/* POLL_FD, POLL_MSG or POLL_SIG 		*/
+	int id;				/* fd, sender pid or signal mask 		*/
+	unsigned int events;		/* POLLIN and/or POLLOUT 			*/
+	unsigned int revents;		/* events that are ready, set by syspoll() 	*/
+};
+
+typedef struct wait wait_t;		/* proc waiting in syspoll() for a device 	*/
+struct wait
+{
+	pcb_t *p;
+	wait_t *next;
+};
+
+typedef struct blkdev blkdev_t;		/* block device behind the buffer cache, held in dvioblk 	*/
+struct blkdev
+{
+	unsigned int nblks;		/* device size in BLK_SZ blocks 		*/
+	int (*bread)();			/* read a block into a kernel buffer 		*/
+	int (*bwrite)();		/* write a block from a kernel buffer 		*/
+};
+
 typedef struct devsw devsw_t;
 struct devsw 
 {
-	unsigned int dvowner;		/* proc which is currently using this device 	*/
+	unsigned int dvopens;		/* fds which currently have this device open 	*/
 	unsigned int dvnum;		/* dev major number 				*/
 	char *devname;
 	int (*dvinit)();		
@@ -346,7 +632,7 @@ struct devsw
 	int (*dvseek)();
 	int (*dvgetc)();
 	int (*dvputc)();
-	int (*dvcntl)();		/* manipulate keyboard eof			*/
+	int (*dvcntl)();		/* device specific commands			*/
 	void *dvcsr;
 	void *dvivec;
 	void *dvovec;
@@ -354,6 +640,10 @@ struct devsw
 	int (*dvoint)();
 	void *dvioblk;
 	int dvminor;
+	int (*dvcancel)();		/* withdraw a proc blocked on the device 	*/
+	int (*dvpoll)();		/* get the poll events an fd is ready for 	*/
+	wait_t *dvwait;			/* procs polling the device 			*/
+	int (*dvref)();			/* count fds taking or dropping a unit, for devices with per-unit state */
 };
 
 pcb_t proc_table[PROC_SZ];             	/* list of process control blocks       */
@@ -366,8 +656,11 @@ devsw_t dev_table[DEV_SZ];		/* list of devices 			*/
 void bzero(void *base, int cnt);
 void bcopy(const void *src, void *dest, unsigned int n);
 int kprintf(char * fmt, ...);
+void kbmwrite(unsigned char *buf, int len);
 void lidt(void);
 void init8259(void);
+void initPIT(int divisor);
+void enable_irq(unsigned int irq, int disable);
 void disable(void);
 void outb(unsigned int, unsigned char);
 unsigned char inb(unsigned int);
@@ -384,6 +677,82 @@ extern void kfree(void *ptr);
 extern void kmemprint(void);
 extern int kmemhdsize(void);            /* get size of head free mem block              */
 extern int kmemtotalsize(void);         /* get total size from all free mem blocks      */
+extern Bool kmemvalid(void *ptr, int len);      /* check range lies within one heap region      */
+extern int kmem_stats(kmem_stats_t *stats);     /* fill in the allocator counters               */
+extern void kmem_trace(Bool on);                /* start or stop recording kmalloc/kfree        */
+extern int kmem_trace_read(pcb_t *p, kmem_trace_t *buf, int n);        /* get the latest trace records */
+extern void puts_kmem_stats(void);
+extern void puts_kmem_trace(void);
+
+extern char *maxaddr;                           /* end of usable memory (set in i386.c)         */
+extern unsigned int page_pool_base;             /* page pool bounds (set in buddy.c)            */
+extern unsigned int page_pool_end;
+extern mem_region_t mem_map[MEM_REGIONS];       /* usable memory regions, ordered by address    */
+extern int mem_regions;
+
+
+/* page allocator */
+extern void buddy_init(unsigned int base, unsigned int end);
+extern int page_order(int size);                        /* get smallest block order holding size bytes  */
+extern void *page_alloc(int order);                     /* allocate 2^order pages                       */
+extern void page_free(void *addr);
+extern Bool is_page(void *addr);                        /* check address lies within the page pool      */
+extern int page_size(void *addr);                       /* get size of an allocated block               */
+extern int page_count(void);                            /* get number of free pages                     */
+extern int page_blocks(int order);                      /* get number of free blocks of an order        */
+extern void puts_page_q(void);
+
+
+/* virtual memory unit */
+extern void vm_init(void);
+extern int vm_alloc(pcb_t *p, int stack);               /* create proc address space with a reserved stack      */
+extern void vm_free(pcb_t *p);                          /* release proc address space and committed pages       */
+extern void vm_switch(pcb_t *p);                        /* load proc address space                              */
+extern void *vm_phys(pcb_t *p, void *va);               /* get kernel address of a proc virtual address         */
+extern int vm_copy(pcb_t *dp, void *dst, pcb_t *sp, void *src, int len);       /* copy between address spaces  */
+extern Bool validate_range(pcb_t *p, void *buf, int len);       /* check buffer is memory proc may pass in  */
+extern int copy_to_user(pcb_t *p, void *dst, void *src, int len);       /* copy kernel buffer to proc buffer    */
+extern int copy_from_user(pcb_t *p, void *dst, void *src, int len);     /* copy proc buffer to kernel buffer    */
+extern int copy_str_from_user(pcb_t *p, char *dst, char *src, int len);    /* copy proc string to kernel buffer */
+extern int clear_user(pcb_t *p, void *dst, int len);    /* zero fill proc buffer                                */
+extern void *frame_alloc(void);                         /* get a free zeroed page frame                         */
+extern void frame_free(void *frame);
+extern void *vm_grow(pcb_t *p, unsigned int size);      /* extend proc heap arena                               */
+extern int vm_shrink(pcb_t *p, unsigned int addr);      /* cut proc heap arena back to addr                     */
+extern void vm_map(pcb_t *p, unsigned int va, unsigned int *pt);      /* install or remove a shared page table  */
+extern int vm_fork(pcb_t *child, pcb_t *parent);        /* clone proc address space copy-on-write               */
+extern void stack_cache_init(void);                     /* pre-populate the stack cache                         */
+extern int stack_cache_drain(void);                     /* release all cached address spaces                    */
+extern void stack_cache_stats(unsigned int *hits, unsigned int *misses);
+extern void puts_stack_cache(void);
+
+
+/* shared memory unit */
+extern void *shm_create(pcb_t *p, int key, unsigned int size);  /* create and attach a named segment    */
+extern void *shm_attach(pcb_t *p, int key);             /* map a named segment into proc                        */
+extern int shm_detach(pcb_t *p, void *addr);            /* unmap a segment, released on its last detach         */
+extern void shm_release(pcb_t *p);                      /* detach every segment of a stopping proc              */
+extern void shm_fork(pcb_t *child, pcb_t *parent);      /* attach the segments of a proc to its clone           */
+extern Bool shm_mapped(pcb_t *p, unsigned int va, int len);     /* check range lies in an attached segment      */
+extern void puts_shm(void);
+
+
+/* buffer cache unit */
+extern void bcache_init(void);
+extern int bcache_read(blkdev_t *b, unsigned int off, pcb_t *p, void *buf, int len);    /* copy device bytes to a proc buffer   */
+extern int bcache_write(blkdev_t *b, unsigned int off, pcb_t *p, void *buf, int len);   /* copy a proc buffer to device bytes   */
+extern int bcache_sync(blkdev_t *b);                    /* write back the dirty blocks of a device, NULL for all        */
+extern void bcache_stats(unsigned int *hits, unsigned int *misses);
+extern void puts_bcache(void);
+
+
+/* kernel log unit */
+extern int klog(int level, char *fmt, ...);             /* append a formatted record to the log                 */
+extern void klog_write(int level, char *buf, int len);  /* append text, each line gets a level and timestamp    */
+extern void klog_tick(void);                            /* advance the log clock and drain a batch to screen    */
+extern void klog_flush(void);                           /* drain the whole log to screen, before halting or console output */
+extern int klog_read(pcb_t *p, void *buf, int len);     /* copy the oldest unread records to a proc buffer      */
+extern void puts_klog(void);
 
 
 /* process management unit */
@@ -397,6 +766,13 @@ extern Bool deadlock(pcb_t *q, pcb_t *p);               /* deadlock detection fo
 extern void release(pcb_t **q);                         /* releases blocked sender/receiver back into ready_q   */
 extern pcb_t* get_proc(int pid);                        /* get pcb_t from the proc_table of the provided pid    */
 extern int count(void);                                 /* get number of proc pcb in the ready_q                */
+extern void ready_head(pcb_t *p);                       /* put proc pcb at the head of its ready_q level        */
+extern Bool unready(pcb_t *p);                          /* remove proc pcb from its ready_q level               */
+extern int yield_to(pcb_t *p, unsigned int pid);        /* hand the rest of the quantum to a ready proc         */
+extern int sched_hint(unsigned int pid, unsigned int hint);     /* set the scheduler hint of a proc             */
+extern unsigned int quantum(pcb_t *p);                  /* get the quantum in ticks for a proc                  */
+extern void boost(void);                                /* move every proc back to the highest ready_q level    */
+extern int sched_info(pcb_t *p, sched_info_t *info);    /* fill in the scheduler settings for a proc            */
 void puts_ready_q(void);                                
 void puts_blocked_q(void);
 void puts_receive_any (void);
@@ -404,6 +780,7 @@ void puts_receive_any (void);
 extern void contextinit(void);
 extern int contextswitch(pcb_t *p);
 extern int create(void (*func)(void), int stack); 
+extern int fork(pcb_t *parent);                         /* clone proc, its pages are shared copy-on-write       */
 extern unsigned int find_pid(void);                     /* return next available pid within MIN_PID and MAX_PID */
 extern void set_max_pid(void);
 extern void set_min_pid(void);
@@ -413,16 +790,32 @@ extern void set_min_pid(void);
 extern int syscall(int call, ...);
 extern int syscreate(void (*func)(void), int stack);
 extern void sysyield(void);
+extern int sysyield_to(unsigned int pid);
+extern int sysschedhint(unsigned int pid, unsigned int hint);
+extern int sysquantum(unsigned int milliseconds);
+extern int sysclock(unsigned int hz);
 extern void sysstop(void);
 
 
 /* auxiliary system calls */
 extern unsigned int sysmalloc (unsigned int size);
+extern int sysfree(void *ptr);
+extern void *sysshmcreate(int key, unsigned int size);
+extern void *sysshmattach(int key);
+extern int sysshmdetach(void *addr);
 extern int syssend(unsigned int dest_pid, void *buffer, int buffer_len);
 extern int sysrecv(unsigned int *from_pid, void *buffer, int buffer_len);
 extern unsigned int syssleep(unsigned int milliseconds);
 extern unsigned int sysgetpid(void);
-extern void sysputs(char *str);
+extern int sysputs(char *str);
+extern int sysschedinfo(sched_info_t *info);
+extern int sysmemstats(kmem_stats_t *stats);
+extern int sysmemtrace(int on, kmem_trace_t *buf, int n);
+extern int sysfork(void);
+extern int syslogread(void *buf, int len);
+extern int syspoll(pollfd_t *set, int n, int timeout_ms);
+extern int sysrtset(unsigned int period_ms, unsigned int budget_ms, unsigned int deadline_ms);
+extern int sysrtwait(void);
 
 extern int syssighandler(int sig_no, void (*new_handler)(void *), void (** old_handler)(void *));
 extern void sigreturn(void *old_sp, int old_rc, unsigned int old_im);
@@ -434,6 +827,7 @@ extern int sysclose(int fd);
 extern int syswrite(int fd, void *buff, int bufflen);
 extern int sysread(int fd, void *buff, int bufflen);
 extern int sysioctl(int fd, unsigned long command, ...);
+extern int syspipe(int *fds);
 
 
 /* user processes */
@@ -449,13 +843,27 @@ extern void proc4(void);
 extern unsigned int sleep(pcb_t *p);    
 extern void wake(void);                                 /* get head proc pcb in the sleep_q                             */
 extern void wake_early(pcb_t *p);
+extern unsigned int unsleep(pcb_t *p);                  /* take proc off the sleep_q, get its slices left       */
 extern unsigned int sleeper (void);                     /* count number of proc pcb in the sleep_q                      */
-extern unsigned int sleep_to_slice (unsigned int ms);   /* convert ms to number of slices, ms / (CLOCK_DIVISOR/10)      */
+extern unsigned int sleep_to_slice (unsigned int ms);   /* convert ms to number of slices, ms * clock_hz / 1000         */
 extern void puts_sleep_q(void);
 
 
 /* hardware timer */
 extern unsigned int tick(void);
+extern int clock_rate(unsigned int hz);                 /* reprogram the timer tick rate                                */
+
+
+/* real-time scheduler */
+extern int rt_set(pcb_t *p, unsigned int period_ms, unsigned int budget_ms, unsigned int deadline_ms);	/* admit proc into the real-time class 	*/
+extern void rt_ready(pcb_t *p);                         /* put proc pcb in the rt_q ordered by deadline                 */
+extern pcb_t* rt_next(void);                            /* get rt_q head proc pcb                                       */
+extern int rt_count(void);                              /* get number of proc pcb in the rt_q                           */
+extern int rt_admitted(void);                           /* get number of proc in the real-time class                    */
+extern void rt_wait(pcb_t *p);                          /* complete the current job and wait for the next release       */
+extern void rt_tick(void);                              /* advance real-time clock and release due jobs                 */
+extern Bool rt_charge(pcb_t *p);                        /* charge a timer tick against the proc budget                  */
+extern void puts_rt_q(void);
 
 
 /* ipc */
@@ -475,11 +883,32 @@ extern void puts_sig_mask(void);
 
 
 /* device driver */
+extern int di_register(devsw_t *d);
 extern int di_open(pcb_t *p, int device_no);
 extern int di_close(pcb_t *p, int fd);
 extern int di_write(pcb_t *p, int fd, void *buf, int buflen);
 extern int di_read(pcb_t *p, int fd, void *buf, int buflen);
 extern int di_ioctl(pcb_t *p, int fd, unsigned long command, ...);
+extern int di_pipe(pcb_t *p, int *fds);
+extern void di_fork(pcb_t *child, pcb_t *parent);
+extern void di_release(pcb_t *p);
+extern void di_cancel(pcb_t *p);
+extern void di_complete(pcb_t *p, fd_t *f, int rc);
+extern unsigned int di_poll(pcb_t *p, int fd, unsigned int events);
+extern void di_wake(devsw_t *d);
+
+/* poll unit */
+extern void poll(pcb_t *p, pollfd_t *set, int n, int timeout_ms);     /* wait for any entry of a set to be ready      */
+extern Bool poll_wake(pcb_t *p);                        /* recheck a polling proc, completing its poll when ready       */
+extern void poll_timeout(pcb_t *p);                     /* complete a poll whose timeout is up                          */
+extern void poll_signal(pcb_t *p);                      /* complete a poll interrupted by a signal                      */
+extern void cons_init();
+extern void uart_init();
+extern void pipe_init();
+extern void ram_init();
+extern int pipe_create();
+extern int uart_iint();
+extern void cons_flush(void);									/* write buffered console output to the screen 	*/
 
 /* test processes */
 extern void sndtest_root(void);
@@ -487,3 +916,9 @@ extern void rcvtest_root(void);
 extern void timetest_root(void);
 extern void sigtest_root(void);
 extern void devtest_root(void);
+extern void polltest_root(void);
+extern void pipetest_root(void);
+extern void ramtest_root(void);
+extern void kbdtest_root(void);
+extern void fdtest_root(void);
+extern void asynctest_root(void);
@@ -42,6 +42,8 @@ int fprintf(int dev, char *fmt, int args);
 int fputs(register char *s,  register int dev);
 char *gets(char *s);
 char * index(char *sp, char c);
+void *malloc(unsigned int size);
+void free(void *ptr);
 void memset(void *pch, int c, int len);
 int printf(char *fmt, int args);
 int puts(register char *s);
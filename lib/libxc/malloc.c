@@ -0,0 +1,157 @@
+
+#include <xeroslib.h>
+#include <i386.h>
+
+#define NULL    0
+
+/*
+ *  Process heap allocator
+ *
+ *  Every process owns a private heap arena at VM_HEAP_BASE, grown and
+ *  shrunk with sysmalloc()/sysfree().  The allocator state lives in the
+ *  first bytes of the arena itself, so each process gets its own state
+ *  without any locking.  Blocks up to ARENA_SMALL bytes are kept on one
+ *  free list per power-of-two size class, larger blocks on a first-fit list.
+ */
+
+#define ARENA_MAGIC	0x6865617f		/* arena state has been set up */
+#define ARENA_BINS	8			/* size classes of 16 .. 2048 bytes */
+#define ARENA_SMALL	(16 << (ARENA_BINS - 1))
+#define ARENA_GROW	(16 * NBPG)		/* least amount the arena grows by */
+#define ARENA_TRIM	(32 * NBPG)		/* free space at the top returned to the kernel */
+
+extern unsigned int sysmalloc(unsigned int size);
+extern int sysfree(void *ptr);
+
+typedef struct mblk mblk_t;
+struct mblk
+{
+  unsigned int size;				/* block size, header included */
+  mblk_t *next;					/* next free block of the list */
+};
+
+struct arena
+{
+  unsigned int magic;
+  char *top;					/* first byte not yet carved */
+  char *end;					/* first byte past the arena */
+  mblk_t *bins[ARENA_BINS];
+  mblk_t *large;
+};
+
+
+static struct arena *arena_get(void)
+{
+  struct arena *a = (struct arena *) VM_HEAP_BASE;
+
+  /* first arena page reads back zero until it has been set up */
+  if (a->magic != ARENA_MAGIC) {
+    a->magic = ARENA_MAGIC;
+    a->top = (char *) VM_HEAP_BASE + sizeof(struct arena);
+    a->end = (char *) sysmalloc(0);
+  }
+  return a;
+}
+
+static int arena_bin(unsigned int size)
+{
+  int i = 0;
+
+  while ((16 << i) < size)
+    i++;
+  return i;
+}
+
+static mblk_t *arena_carve(struct arena *a, unsigned int size)
+{
+  mblk_t *b;
+  unsigned int grow;
+
+  if (a->end - a->top < size) {
+    grow = size - (a->end - a->top);
+    if (grow < ARENA_GROW)
+      grow = ARENA_GROW;
+    if (!sysmalloc(grow))
+      return NULL;
+    a->end += PG_ROUND(grow);
+  }
+
+  b = (mblk_t *) a->top;
+  b->size = size;
+  a->top += size;
+  return b;
+}
+
+/*
+ *  Allocate size bytes from the process heap, NULL when the arena is full
+ */
+void *malloc(unsigned int size)
+{
+  struct arena *a = arena_get();
+  mblk_t *b, **prev, *rest;
+  int i;
+
+  size = (size + sizeof(mblk_t) + 15) & ~15;
+
+  if (size <= ARENA_SMALL) {
+    i = arena_bin(size);
+    if ((b = a->bins[i]))
+      a->bins[i] = b->next;
+    else
+      b = arena_carve(a, 16 << i);
+    return b ? b + 1 : NULL;
+  }
+
+  for (prev = &a->large; (b = *prev); prev = &b->next) {
+    if (b->size < size)
+      continue;
+    *prev = b->next;
+
+    /* split off the tail while it is still a large block */
+    if (b->size - size > ARENA_SMALL) {
+      rest = (mblk_t *) ((char *) b + size);
+      rest->size = b->size - size;
+      rest->next = a->large;
+      a->large = rest;
+      b->size = size;
+    }
+    return b + 1;
+  }
+
+  b = arena_carve(a, size);
+  return b ? b + 1 : NULL;
+}
+
+/*
+ *  Return a block from malloc() to the process heap
+ */
+void free(void *ptr)
+{
+  struct arena *a = arena_get();
+  mblk_t *b;
+  char *end;
+  int i;
+
+  if (!ptr)
+    return;
+  b = (mblk_t *) ptr - 1;
+
+  if (b->size <= ARENA_SMALL) {
+    i = arena_bin(b->size);
+    b->next = a->bins[i];
+    a->bins[i] = b;
+    return;
+  }
+
+  /* large block at the top of the arena goes back to the carve area */
+  if ((char *) b + b->size == a->top) {
+    a->top = (char *) b;
+    end = (char *) PG_ROUND((unsigned int) a->top);
+    if (a->end - end >= ARENA_TRIM && sysfree(end) == 0)
+      a->end = end;
+    return;
+  }
+
+  b->next = a->large;
+  a->large = b;
+}